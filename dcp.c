@@ -1,4 +1,5 @@
 #include "dcp.h"
+#include "dcp_fec.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -19,18 +20,11 @@ static void list_del_seg(DCPSEG *node) {
     node->next->prev = node->prev;
 }
 
-static void list_add_before(DCPSEG *pos, DCPSEG *node) {
-    node->next = pos;
-    node->prev = pos->prev;
-    pos->prev->next = node;
-    pos->prev = node;
-}
 
 
 static DCPSEG* dcp_seg_create(DCPCB *dcp, int size) {
-    dcp_malloc_fn malloc_fn = dcp_get_malloc();
     int data_size = (size < 0) ? 0 : size;
-    DCPSEG *seg = (DCPSEG*)malloc_fn(sizeof(DCPSEG) + data_size);
+    DCPSEG *seg = (DCPSEG*)dcp_pool_alloc(dcp->scheduler->seg_pool, sizeof(DCPSEG) + data_size);
     if (seg == NULL) return NULL;
     memset(seg, 0, sizeof(DCPSEG));
     seg->len = data_size;
@@ -39,10 +33,23 @@ static DCPSEG* dcp_seg_create(DCPCB *dcp, int size) {
 
 static void dcp_seg_free(DCPCB *dcp, DCPSEG *seg) {
     if (seg) {
-        dcp_get_free()(seg);
+        dcp_scheduler_retire(dcp->scheduler, seg);
     }
 }
 
+static inline void dcp_trace(DCPCB *dcp, uint32_t type, uint32_t now, uint32_t a, uint32_t b,
+                             uint64_t c, uint32_t flags) {
+#ifndef DCP_DISABLE_TRACE
+    if (!dcp->trace || dcp->scheduler->trace == NULL) return;
+
+    uint64_t time_us = dcp->scheduler->now_us;
+    if (time_us < (uint64_t)now * 1000) time_us = (uint64_t)now * 1000;
+    dcp_trace_record(dcp->scheduler->trace, type, time_us, dcp->conv_id, a, b, c, flags);
+#else
+    (void)dcp; (void)type; (void)now; (void)a; (void)b; (void)c; (void)flags;
+#endif
+}
+
 static inline void _dcp_encode_32u(char *p, uint32_t v) {
     p[0] = (char)(v >> 24);
     p[1] = (char)(v >> 16);
@@ -57,50 +64,571 @@ static inline void _dcp_decode_32u(const char *p, uint32_t *v) {
          ((uint32_t)(unsigned char)p[3]);
 }
 
-static char* dcp_encode_seg(char *ptr, const DCPSEG *seg) {
+static inline void _dcp_encode_16u(char *p, uint16_t v) {
+    p[0] = (char)(v >> 8);
+    p[1] = (char)(v);
+}
+
+static inline uint16_t _dcp_decode_16u(const char *p) {
+    return (uint16_t)(((unsigned char)p[0] << 8) | (unsigned char)p[1]);
+}
+
+static inline char* _dcp_encode_varint(char *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (char)v;
+    return p;
+}
+
+static inline const char* _dcp_decode_varint(const char *p, const char *end, uint32_t *v) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        unsigned char b = (unsigned char)*p++;
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *v = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t dcp_expand_16(uint32_t ref, uint16_t v) {
+    return ref + (uint32_t)(int32_t)(int16_t)(v - (uint16_t)ref);
+}
+
+static char* dcp_encode_seg(const DCPCB *dcp, char *ptr, const DCPSEG *seg) {
     _dcp_encode_32u(ptr, seg->conv_id); ptr += 4;
-    _dcp_encode_32u(ptr, seg->cmd);     ptr += 4;
-    _dcp_encode_32u(ptr, seg->frg);     ptr += 4;
-    _dcp_encode_32u(ptr, seg->wnd);     ptr += 4;
-    _dcp_encode_32u(ptr, seg->ts);      ptr += 4;
-    _dcp_encode_32u(ptr, seg->sn);      ptr += 4;
-    _dcp_encode_32u(ptr, seg->una);     ptr += 4;
-    _dcp_encode_32u(ptr, seg->len);     ptr += 4;
+
+    if (!dcp->hdr_compact || !dcp->hdr_compact_peer) {
+        uint32_t cmd = seg->cmd | (dcp->hdr_compact ? DCP_HDR_CAP_COMPACT : 0);
+        _dcp_encode_32u(ptr, cmd);      ptr += 4;
+        _dcp_encode_32u(ptr, seg->frg); ptr += 4;
+        _dcp_encode_32u(ptr, seg->wnd); ptr += 4;
+        _dcp_encode_32u(ptr, seg->ts);  ptr += 4;
+        _dcp_encode_32u(ptr, seg->sn);  ptr += 4;
+        _dcp_encode_32u(ptr, seg->una); ptr += 4;
+        _dcp_encode_32u(ptr, seg->len); ptr += 4;
+        return ptr;
+    }
+
+    int wide = (dcp->snd_nxt - dcp->snd_una >= DCP_HDR_NARROW_SPAN ||
+                dcp->rcv_wnd >= DCP_HDR_NARROW_SPAN);
+    uint8_t flags = DCP_HDR_COMPACT | (seg->cmd & DCP_HDR_CMD_MASK);
+    if (wide) flags |= DCP_HDR_WIDE;
+    if (seg->frg) flags |= DCP_HDR_FRG;
+
+    *ptr++ = (char)flags;
+    _dcp_encode_16u(ptr, (uint16_t)(seg->wnd > 0xFFFF ? 0xFFFF : seg->wnd)); ptr += 2;
+    ptr[0] = (char)(seg->ts >> 16);
+    ptr[1] = (char)(seg->ts >> 8);
+    ptr[2] = (char)(seg->ts);
+    ptr += 3;
+    if (wide) {
+        _dcp_encode_32u(ptr, seg->sn);  ptr += 4;
+        _dcp_encode_32u(ptr, seg->una); ptr += 4;
+    } else {
+        _dcp_encode_16u(ptr, (uint16_t)seg->sn);  ptr += 2;
+        _dcp_encode_16u(ptr, (uint16_t)seg->una); ptr += 2;
+    }
+    if (seg->frg) {
+        ptr = _dcp_encode_varint(ptr, seg->frg);
+    }
     return ptr;
 }
 
-static const char* dcp_decode_seg(const char *ptr, DCPSEG *seg) {
+static const char* dcp_decode_seg(DCPCB *dcp, const char *ptr, long size, DCPSEG *seg, uint32_t now) {
+    const char *end = ptr + size;
+
+    if (size < DCP_OVERHEAD_MIN) return NULL;
     _dcp_decode_32u(ptr, &seg->conv_id); ptr += 4;
-    _dcp_decode_32u(ptr, &seg->cmd);     ptr += 4;
-    _dcp_decode_32u(ptr, &seg->frg);     ptr += 4;
-    _dcp_decode_32u(ptr, &seg->wnd);     ptr += 4;
-    _dcp_decode_32u(ptr, &seg->ts);      ptr += 4;
-    _dcp_decode_32u(ptr, &seg->sn);      ptr += 4;
-    _dcp_decode_32u(ptr, &seg->una);     ptr += 4;
-    _dcp_decode_32u(ptr, &seg->len);     ptr += 4;
+
+    uint8_t flags = (uint8_t)*ptr;
+    if ((flags & DCP_HDR_COMPACT) == 0) {
+        if (size < DCP_OVERHEAD) return NULL;
+        _dcp_decode_32u(ptr, &seg->cmd); ptr += 4;
+        _dcp_decode_32u(ptr, &seg->frg); ptr += 4;
+        _dcp_decode_32u(ptr, &seg->wnd); ptr += 4;
+        _dcp_decode_32u(ptr, &seg->ts);  ptr += 4;
+        _dcp_decode_32u(ptr, &seg->sn);  ptr += 4;
+        _dcp_decode_32u(ptr, &seg->una); ptr += 4;
+        _dcp_decode_32u(ptr, &seg->len); ptr += 4;
+        if (seg->cmd & DCP_HDR_CAP_COMPACT) {
+            seg->cmd &= ~DCP_HDR_CAP_COMPACT;
+            dcp->hdr_compact_peer = 1;
+        }
+        return (seg->len == (uint32_t)(end - ptr)) ? ptr : NULL;
+    }
+
+    ptr++;
+    seg->cmd = 0x50 | (flags & DCP_HDR_CMD_MASK);
+    seg->wnd = _dcp_decode_16u(ptr); ptr += 2;
+
+    uint32_t ts = ((uint32_t)(unsigned char)ptr[0] << 16) |
+                  ((uint32_t)(unsigned char)ptr[1] << 8) |
+                  ((uint32_t)(unsigned char)ptr[2]);
+    ptr += 3;
+    seg->ts = now - ((now - ts) & DCP_HDR_TS_MASK);
+
+    uint32_t sn_ref = (seg->cmd == DCP_CMD_PUSH || seg->cmd == DCP_CMD_FEC) ? dcp->rcv_nxt : dcp->snd_una;
+    if (flags & DCP_HDR_WIDE) {
+        if (end - ptr < 8) return NULL;
+        _dcp_decode_32u(ptr, &seg->sn);  ptr += 4;
+        _dcp_decode_32u(ptr, &seg->una); ptr += 4;
+    } else {
+        seg->sn = dcp_expand_16(sn_ref, _dcp_decode_16u(ptr));        ptr += 2;
+        seg->una = dcp_expand_16(dcp->snd_una, _dcp_decode_16u(ptr)); ptr += 2;
+    }
+
+    seg->frg = 0;
+    if ((flags & DCP_HDR_FRG) && (ptr = _dcp_decode_varint(ptr, end, &seg->frg)) == NULL) {
+        return NULL;
+    }
+    seg->len = (uint32_t)(end - ptr);
+
+    dcp->hdr_compact_peer = 1;
     return ptr;
 }
 
+static void dcp_batch_flush(DCPCB *dcp) {
+    if (dcp->batch_count == 0) return;
+
+    dcp->output_batch(dcp->batch, dcp->batch_count, dcp, dcp->user);
+
+    for (int i = 0; i < dcp->batch_count; i++) {
+        dcp_pool_free(dcp->scheduler->seg_pool, (void*)dcp->batch[i].data);
+    }
+    dcp->batch_count = 0;
+}
+
 static int _dcp_output_seg(DCPCB *dcp, DCPSEG *seg) {
-    if (dcp->output == NULL) return -1;
+    if (dcp->output == NULL && dcp->outputv == NULL && dcp->output_batch == NULL) return -1;
     
-    char buffer[DCP_MTU_DEF];
     if (seg->len + DCP_OVERHEAD > dcp->mtu) return -2;
+    int len = seg->len + DCP_OVERHEAD;
+
+    if (dcp->batch != NULL) {
+        char *packet = (char*)dcp_pool_alloc(dcp->scheduler->seg_pool, len);
+        if (packet == NULL) return -3;
+
+        char *ptr = dcp_encode_seg(dcp, packet, seg);
+        if (seg->len > 0) {
+            memcpy(ptr, seg->data, seg->len);
+        }
+
+        dcp->batch[dcp->batch_count].data = packet;
+        dcp->batch[dcp->batch_count].len = (int)(ptr - packet) + seg->len;
+        if (++dcp->batch_count == DCP_BATCH_MAX) {
+            dcp_batch_flush(dcp);
+        }
+        return 0;
+    }
+
+    if (dcp->outputv) {
+        char header[DCP_OVERHEAD];
+        struct iovec iov[2];
+
+        iov[0].iov_base = header;
+        iov[0].iov_len = dcp_encode_seg(dcp, header, seg) - header;
+        iov[1].iov_base = seg->data;
+        iov[1].iov_len = seg->len;
+        return dcp->outputv(iov, (seg->len > 0) ? 2 : 1, dcp, dcp->user);
+    }
     
-    char *ptr = dcp_encode_seg(buffer, seg);
+    char stack_buffer[DCP_MTU_DEF];
+    char *buffer = stack_buffer;
+    if (len > DCP_MTU_DEF) {
+        buffer = (char*)dcp_pool_alloc(dcp->scheduler->seg_pool, len);
+        if (buffer == NULL) return -3;
+    }
+
+    char *ptr = dcp_encode_seg(dcp, buffer, seg);
     if (seg->len > 0) {
         memcpy(ptr, seg->data, seg->len);
     }
+    len = (int)(ptr - buffer) + seg->len;
     
-    return dcp->output(buffer, seg->len + DCP_OVERHEAD, dcp, dcp->user);
+    int ret;
+    if (dcp->output == NULL) {
+        DCPPacket packet;
+        packet.data = buffer;
+        packet.len = len;
+        ret = dcp->output_batch(&packet, 1, dcp, dcp->user);
+    } else {
+        ret = dcp->output(buffer, len, dcp, dcp->user);
+    }
+
+    if (buffer != stack_buffer) {
+        dcp_pool_free(dcp->scheduler->seg_pool, buffer);
+    }
+    return ret;
+}
+
+static void dcp_rate_on_sent(DCPCB *dcp, DCPSEG *seg, uint32_t now) {
+    if (dcp->inflight_bytes == 0) {
+        dcp->first_sent_ts = now;
+        dcp->delivered_ts = now;
+    }
+    seg->delivered = dcp->delivered;
+    seg->delivered_ts = dcp->delivered_ts;
+    seg->first_sent_ts = dcp->first_sent_ts;
+    seg->is_app_limited = (dcp->app_limited != 0);
+}
+
+static void dcp_rate_begin(DCPCB *dcp) {
+    memset(&dcp->rs, 0, sizeof(DCPRateSample));
+    dcp->rs.interval_ms = -1;
+    dcp->rs.rtt_ms = -1;
+}
+
+static void dcp_rate_on_delivered(DCPCB *dcp, DCPSEG *seg, uint32_t xmit, uint32_t now) {
+    DCPRateSample *rs = &dcp->rs;
+    uint32_t bytes = seg->len + DCP_OVERHEAD;
+
+    dcp->delivered += bytes;
+    dcp->delivered_ts = now;
+    dcp->inflight_bytes -= (dcp->inflight_bytes < bytes) ? dcp->inflight_bytes : bytes;
+    rs->acked_bytes += bytes;
+
+    if (rs->interval_ms < 0 || seg->delivered > rs->prior_delivered) {
+        rs->prior_delivered = seg->delivered;
+        rs->prior_ts = seg->delivered_ts;
+        rs->is_app_limited = seg->is_app_limited;
+        rs->interval_ms = (int32_t)(seg->ts - seg->first_sent_ts);
+        dcp->first_sent_ts = seg->ts;
+    }
+
+    if (xmit == 1) {
+        rs->rtt_ms = (int32_t)(now - seg->ts);
+    }
+}
+
+static void dcp_rate_gen(DCPCB *dcp) {
+    DCPRateSample *rs = &dcp->rs;
+
+    if (dcp->app_limited && dcp->delivered > dcp->app_limited) {
+        dcp->app_limited = 0;
+    }
+
+    if (rs->acked_bytes == 0 || rs->interval_ms < 0) {
+        rs->interval_ms = -1;
+        return;
+    }
+
+    rs->delivered = (uint32_t)(dcp->delivered - rs->prior_delivered);
+
+    int32_t ack_elapsed = (int32_t)(dcp->delivered_ts - rs->prior_ts);
+    if (ack_elapsed > rs->interval_ms) {
+        rs->interval_ms = ack_elapsed;
+    }
+    if (rs->interval_ms < 1 || rs->interval_ms < dcp->rack_min_rtt) {
+        rs->interval_ms = -1;
+        return;
+    }
+
+    rs->delivery_rate = (uint64_t)rs->delivered * 1000 / (uint32_t)rs->interval_ms;
+}
+
+static int dcp_cwnd_open(DCPCB *dcp, uint32_t slack) {
+    uint32_t cwnd = dcp->cc_ops->get_cwnd(dcp);
+    uint32_t rmt_wnd = (dcp->rmt_wnd > 0) ? dcp->rmt_wnd : 1;
+
+    if (dcp->fec_enc) {
+        cwnd = (uint32_t)((uint64_t)cwnd * dcp->fec_k / (dcp->fec_k + dcp->fec_m));
+    }
+    if (cwnd < dcp->mss) cwnd = dcp->mss;
+    if (dcp->nocwnd == 0 && dcp->snd_buf_len >= rmt_wnd + slack) return 0;
+    return dcp->inflight_bytes < cwnd + slack * dcp->mss;
+}
+
+static void dcp_rate_check_app_limited(DCPCB *dcp) {
+    if (dcp->snd_queue_len == 0 && dcp_cwnd_open(dcp, 0)) {
+        uint64_t mark = dcp->delivered + dcp->inflight_bytes;
+        dcp->app_limited = mark ? mark : 1;
+    }
+}
+
+#define DCP_BBR_UNIT             256
+#define DCP_BBR_HIGH_GAIN        (DCP_BBR_UNIT * 2885 / 1000 + 1)
+#define DCP_BBR_DRAIN_GAIN       (DCP_BBR_UNIT * 1000 / 2885)
+#define DCP_BBR_CWND_GAIN        (DCP_BBR_UNIT * 2)
+#define DCP_BBR_FULL_BW_THRESH   (DCP_BBR_UNIT * 5 / 4)
+#define DCP_BBR_FULL_BW_CNT      3
+#define DCP_BBR_CYCLE_LEN        8
+#define DCP_BBR_BW_WIN_ROUNDS    10
+#define DCP_BBR_MIN_RTT_WIN_MS   10000
+#define DCP_BBR_PROBE_RTT_MS     200
+#define DCP_BBR_MIN_CWND_PKTS    4
+#define DCP_BBR_INIT_CWND_PKTS   10
+#define DCP_BBR_LOSS_THRESH      50
+#define DCP_BBR_LOSS_MIN_PKTS    8
+#define DCP_BBR_LOSS_ROUNDS      (DCP_BBR_CYCLE_LEN * 2)
+
+static const uint32_t dcp_bbr_pacing_gain[DCP_BBR_CYCLE_LEN] = {
+    DCP_BBR_UNIT * 5 / 4, DCP_BBR_UNIT * 3 / 4,
+    DCP_BBR_UNIT, DCP_BBR_UNIT, DCP_BBR_UNIT,
+    DCP_BBR_UNIT, DCP_BBR_UNIT, DCP_BBR_UNIT
+};
+
+static uint64_t dcp_minmax_subwin_update(DCPMinMaxSample *m, uint32_t win,
+                                         const DCPMinMaxSample *val) {
+    uint32_t dt = val->t - m[0].t;
+
+    if (dt > win) {
+        m[0] = m[1];
+        m[1] = m[2];
+        m[2] = *val;
+        if (val->t - m[0].t > win) {
+            m[0] = m[1];
+            m[1] = m[2];
+            m[2] = *val;
+        }
+    } else if (m[1].t == m[0].t && dt > win / 4) {
+        m[2] = m[1] = *val;
+    } else if (m[2].t == m[1].t && dt > win / 2) {
+        m[2] = *val;
+    }
+    return m[0].v;
+}
+
+static uint64_t dcp_minmax_running_max(DCPMinMaxSample *m, uint32_t win,
+                                       uint32_t t, uint64_t v) {
+    DCPMinMaxSample val;
+    val.t = t;
+    val.v = v;
+
+    if (val.v >= m[0].v || val.t - m[2].t > win) {
+        m[0] = m[1] = m[2] = val;
+        return m[0].v;
+    }
+
+    if (val.v >= m[1].v) {
+        m[2] = m[1] = val;
+    } else if (val.v >= m[2].v) {
+        m[2] = val;
+    }
+    return dcp_minmax_subwin_update(m, win, &val);
+}
+
+static uint32_t dcp_bbr_bdp(DCPCB *dcp, DCPBBRState *bbr, uint64_t bw, uint32_t gain) {
+    if (bbr->rt_prop == UINT32_MAX) {
+        return DCP_BBR_INIT_CWND_PKTS * dcp->mss;
+    }
+    uint64_t bdp = bw * bbr->rt_prop / 1000;
+    return (uint32_t)((bdp * gain + DCP_BBR_UNIT - 1) / DCP_BBR_UNIT);
+}
+
+static void dcp_bbr_set_pacing_rate(DCPCB *dcp, DCPBBRState *bbr, uint64_t bw, uint32_t gain) {
+    uint64_t rate = bw * gain / DCP_BBR_UNIT * 99 / 100;
+    if (rate == 0) return;
+
+    if (bbr->full_bw_reached || rate > dcp->pace_rate_bytes_per_sec) {
+        dcp->pace_rate_bytes_per_sec = rate;
+    }
+}
+
+static void dcp_bbr_reset_startup(DCPBBRState *bbr) {
+    bbr->state = DCP_BBR_STARTUP;
+    bbr->pacing_gain = DCP_BBR_HIGH_GAIN;
+    bbr->cwnd_gain = DCP_BBR_HIGH_GAIN;
+}
+
+static void dcp_bbr_advance_cycle_phase(DCPBBRState *bbr, uint32_t now) {
+    bbr->cycle_idx = (bbr->cycle_idx + 1) % DCP_BBR_CYCLE_LEN;
+    bbr->cycle_stamp = now;
+    bbr->pacing_gain = dcp_bbr_pacing_gain[bbr->cycle_idx];
+}
+
+static void dcp_bbr_enter_probe_bw(DCPCB *dcp, DCPBBRState *bbr, uint32_t now) {
+    bbr->state = DCP_BBR_PROBE_BW;
+    bbr->cwnd_gain = DCP_BBR_CWND_GAIN;
+    bbr->cycle_idx = DCP_BBR_CYCLE_LEN - 1 - (dcp->conv_id ^ now) % (DCP_BBR_CYCLE_LEN - 1);
+    dcp_bbr_advance_cycle_phase(bbr, now);
+}
+
+static void dcp_bbr_save_cwnd(DCPBBRState *bbr) {
+    if (bbr->state != DCP_BBR_PROBE_RTT && !bbr->packet_conservation) {
+        bbr->prior_cwnd = bbr->cwnd;
+    } else if (bbr->cwnd > bbr->prior_cwnd) {
+        bbr->prior_cwnd = bbr->cwnd;
+    }
+}
+
+static void dcp_bbr_restore_cwnd(DCPBBRState *bbr) {
+    if (bbr->prior_cwnd > bbr->cwnd) {
+        bbr->cwnd = bbr->prior_cwnd;
+    }
+}
+
+static void dcp_bbr_update_bw(DCPCB *dcp, DCPBBRState *bbr) {
+    const DCPRateSample *rs = &dcp->rs;
+
+    bbr->round_start = 0;
+    if (rs->interval_ms <= 0 || rs->delivered == 0) return;
+
+    if (rs->prior_delivered >= bbr->next_round_delivered) {
+        bbr->next_round_delivered = dcp->delivered;
+        bbr->round_count++;
+        bbr->round_start = 1;
+        if (bbr->loss_rounds > 0) bbr->loss_rounds--;
+        uint64_t lost = dcp->lost - bbr->round_lost;
+        if (lost > DCP_BBR_LOSS_MIN_PKTS * dcp->mss &&
+            lost * DCP_BBR_LOSS_THRESH > dcp->delivered - bbr->round_delivered) {
+            if (bbr->state == DCP_BBR_STARTUP) bbr->full_bw_reached = 1;
+            if (bbr->state == DCP_BBR_PROBE_BW) bbr->loss_rounds = DCP_BBR_LOSS_ROUNDS;
+        }
+        bbr->round_lost = dcp->lost;
+        bbr->round_delivered = dcp->delivered;
+    }
+
+    if (!rs->is_app_limited || rs->delivery_rate >= bbr->btl_bw) {
+        bbr->btl_bw = dcp_minmax_running_max(bbr->bw_filter, DCP_BBR_BW_WIN_ROUNDS,
+                                             bbr->round_count, rs->delivery_rate);
+    }
+}
+
+static int dcp_bbr_is_next_cycle_phase(DCPCB *dcp, DCPBBRState *bbr, uint32_t now) {
+    int is_full_length = (now - bbr->cycle_stamp) > bbr->rt_prop;
+
+    if (bbr->pacing_gain == DCP_BBR_UNIT) {
+        return is_full_length;
+    }
+    if (bbr->pacing_gain > DCP_BBR_UNIT) {
+        return is_full_length && (bbr->loss_rounds > 0 ||
+               dcp->inflight_bytes >= dcp_bbr_bdp(dcp, bbr, bbr->btl_bw, bbr->pacing_gain));
+    }
+    return is_full_length ||
+           dcp->inflight_bytes <= dcp_bbr_bdp(dcp, bbr, bbr->btl_bw, DCP_BBR_UNIT);
+}
+
+static void dcp_bbr_update_cycle_phase(DCPCB *dcp, DCPBBRState *bbr, uint32_t now) {
+    if (bbr->state == DCP_BBR_PROBE_BW && dcp_bbr_is_next_cycle_phase(dcp, bbr, now)) {
+        dcp_bbr_advance_cycle_phase(bbr, now);
+    }
+}
+
+static void dcp_bbr_check_full_bw_reached(DCPCB *dcp, DCPBBRState *bbr) {
+    if (bbr->full_bw_reached || !bbr->round_start || dcp->rs.is_app_limited) {
+        return;
+    }
+
+    if (bbr->btl_bw >= bbr->full_bw * DCP_BBR_FULL_BW_THRESH / DCP_BBR_UNIT) {
+        bbr->full_bw = bbr->btl_bw;
+        bbr->full_bw_cnt = 0;
+        return;
+    }
+    if (++bbr->full_bw_cnt >= DCP_BBR_FULL_BW_CNT) {
+        bbr->full_bw_reached = 1;
+    }
+}
+
+static void dcp_bbr_check_drain(DCPCB *dcp, DCPBBRState *bbr, uint32_t now) {
+    if (bbr->state == DCP_BBR_STARTUP && bbr->full_bw_reached) {
+        bbr->state = DCP_BBR_DRAIN;
+        bbr->pacing_gain = DCP_BBR_DRAIN_GAIN;
+        bbr->cwnd_gain = DCP_BBR_HIGH_GAIN;
+    }
+    if (bbr->state == DCP_BBR_DRAIN &&
+        dcp->inflight_bytes <= dcp_bbr_bdp(dcp, bbr, bbr->btl_bw, DCP_BBR_UNIT)) {
+        dcp_bbr_enter_probe_bw(dcp, bbr, now);
+    }
+}
+
+static void dcp_bbr_update_min_rtt(DCPCB *dcp, DCPBBRState *bbr, int32_t rtt, uint32_t now) {
+    int expired = (now - bbr->rt_prop_stamp) > DCP_BBR_MIN_RTT_WIN_MS;
+    uint32_t min_cwnd = DCP_BBR_MIN_CWND_PKTS * dcp->mss;
+
+    if (rtt >= 0 && ((uint32_t)rtt < bbr->rt_prop || expired)) {
+        bbr->rt_prop = (rtt > 0) ? (uint32_t)rtt : 1;
+        bbr->rt_prop_stamp = now;
+    }
+
+    if (expired && !bbr->idle_restart && bbr->state != DCP_BBR_PROBE_RTT) {
+        dcp_bbr_save_cwnd(bbr);
+        bbr->state = DCP_BBR_PROBE_RTT;
+        bbr->pacing_gain = DCP_BBR_UNIT;
+        bbr->cwnd_gain = DCP_BBR_UNIT;
+        bbr->probe_rtt_done_stamp = 0;
+    }
+
+    if (bbr->state == DCP_BBR_PROBE_RTT) {
+        dcp->app_limited = (dcp->delivered + dcp->inflight_bytes) ? (dcp->delivered + dcp->inflight_bytes) : 1;
+
+        if (bbr->probe_rtt_done_stamp == 0 && dcp->inflight_bytes <= min_cwnd) {
+            bbr->probe_rtt_done_stamp = now + DCP_BBR_PROBE_RTT_MS;
+            bbr->probe_rtt_round_done = 0;
+            bbr->next_round_delivered = dcp->delivered;
+        } else if (bbr->probe_rtt_done_stamp != 0) {
+            if (bbr->round_start) {
+                bbr->probe_rtt_round_done = 1;
+            }
+            if (bbr->probe_rtt_round_done && now >= bbr->probe_rtt_done_stamp) {
+                bbr->rt_prop_stamp = now;
+                dcp_bbr_restore_cwnd(bbr);
+                if (bbr->full_bw_reached) {
+                    dcp_bbr_enter_probe_bw(dcp, bbr, now);
+                } else {
+                    dcp_bbr_reset_startup(bbr);
+                }
+            }
+        }
+    }
+
+    if (dcp->rs.delivered > 0) {
+        bbr->idle_restart = 0;
+    }
+}
+
+static void dcp_bbr_set_cwnd(DCPCB *dcp, DCPBBRState *bbr, uint32_t bytes_acked) {
+    uint32_t min_cwnd = DCP_BBR_MIN_CWND_PKTS * dcp->mss;
+
+    if (bytes_acked == 0) goto done;
+
+    if (bbr->packet_conservation) {
+        if (bbr->round_count > bbr->conservation_round) {
+            bbr->packet_conservation = 0;
+            dcp_bbr_restore_cwnd(bbr);
+        } else {
+            uint32_t need = dcp->inflight_bytes + bytes_acked;
+            if (bbr->cwnd < need) bbr->cwnd = need;
+            goto done;
+        }
+    }
+
+    uint32_t gain = bbr->cwnd_gain;
+    if (bbr->loss_rounds > 0) {
+        gain = (bbr->pacing_gain > DCP_BBR_UNIT) ? bbr->pacing_gain : DCP_BBR_UNIT;
+    }
+    uint32_t target = dcp_bbr_bdp(dcp, bbr, bbr->btl_bw, gain) + 3 * dcp->mss;
+    if (bbr->full_bw_reached) {
+        bbr->cwnd = (bbr->cwnd + bytes_acked < target) ? bbr->cwnd + bytes_acked : target;
+    } else if (bbr->cwnd < target || dcp->delivered < DCP_BBR_INIT_CWND_PKTS * dcp->mss) {
+        bbr->cwnd += bytes_acked;
+    }
+    if (bbr->cwnd < min_cwnd) bbr->cwnd = min_cwnd;
+
+done:
+    if (bbr->state == DCP_BBR_PROBE_RTT && bbr->cwnd > min_cwnd) {
+        bbr->cwnd = min_cwnd;
+    }
 }
 
 static void dcp_bbr_init(DCPCB *dcp) {
     dcp_malloc_fn malloc_fn = dcp_get_malloc();
     DCPBBRState *bbr_state = (DCPBBRState*)malloc_fn(sizeof(DCPBBRState));
+    if (bbr_state == NULL) return;
     memset(bbr_state, 0, sizeof(DCPBBRState));
+
+    bbr_state->rt_prop = UINT32_MAX;
+    bbr_state->cwnd = DCP_BBR_INIT_CWND_PKTS * dcp->mss;
+    dcp_bbr_reset_startup(bbr_state);
     dcp->congestion_control_state = bbr_state;
-    dcp->pace_rate_bytes_per_sec = 500 * 1024;
+
+    uint32_t rtt_ms = (dcp->rx_srtt > 0) ? (uint32_t)dcp->rx_srtt : 1;
+    uint64_t bw = (uint64_t)bbr_state->cwnd * 1000 / rtt_ms;
+    dcp->pace_rate_bytes_per_sec = bw * DCP_BBR_HIGH_GAIN / DCP_BBR_UNIT;
 }
 
 static void dcp_bbr_release(DCPCB *dcp) {
@@ -111,15 +639,50 @@ static void dcp_bbr_release(DCPCB *dcp) {
 }
 
 static void dcp_bbr_on_ack(DCPCB *dcp, int32_t rtt_sample, uint32_t bytes_acked, uint32_t now) {
-    
+    DCPBBRState *bbr = (DCPBBRState*)dcp->congestion_control_state;
+    if (bbr == NULL) return;
+
+    int prev_state = bbr->state;
+
+    dcp_bbr_update_bw(dcp, bbr);
+    dcp_bbr_update_cycle_phase(dcp, bbr, now);
+    dcp_bbr_check_full_bw_reached(dcp, bbr);
+    dcp_bbr_check_drain(dcp, bbr, now);
+    dcp_bbr_update_min_rtt(dcp, bbr, rtt_sample, now);
+
+    dcp_bbr_set_pacing_rate(dcp, bbr, bbr->btl_bw, bbr->pacing_gain);
+    dcp_bbr_set_cwnd(dcp, bbr, bytes_acked);
+
+    if (bbr->state != prev_state) {
+        dcp_trace(dcp, DCP_TRACE_CC_STATE, now, (uint32_t)prev_state, (uint32_t)bbr->state,
+                  bbr->btl_bw, 0);
+    }
 }
 
 static void dcp_bbr_on_loss(DCPCB *dcp, uint32_t lost_sn, uint32_t now) {
+    DCPBBRState *bbr = (DCPBBRState*)dcp->congestion_control_state;
+    (void)lost_sn; (void)now;
+    if (bbr == NULL) return;
+
+    if (bbr->packet_conservation) return;
 
+    uint32_t min_cwnd = DCP_BBR_MIN_CWND_PKTS * dcp->mss;
+
+    dcp_bbr_save_cwnd(bbr);
+    bbr->packet_conservation = 1;
+    bbr->conservation_round = bbr->round_count;
+    bbr->next_round_delivered = dcp->delivered;
+    bbr->cwnd = (dcp->inflight_bytes > min_cwnd) ? dcp->inflight_bytes : min_cwnd;
+    if (bbr->state == DCP_BBR_PROBE_BW && bbr->loss_rounds == 0) {
+        uint32_t gain = (bbr->pacing_gain > DCP_BBR_UNIT) ? bbr->pacing_gain : DCP_BBR_UNIT;
+        uint32_t bdp = dcp_bbr_bdp(dcp, bbr, bbr->btl_bw, gain);
+        if (bbr->cwnd < bdp) bbr->cwnd = bdp;
+    }
 }
 
 static uint32_t dcp_bbr_get_cwnd(DCPCB *dcp) {
-    uint32_t cwnd_bytes = 32 * dcp->mss;
+    DCPBBRState *bbr = (DCPBBRState*)dcp->congestion_control_state;
+    uint32_t cwnd_bytes = bbr ? bbr->cwnd : DCP_BBR_INIT_CWND_PKTS * dcp->mss;
     uint32_t rmt_wnd_bytes = dcp->rmt_wnd * dcp->mss;
     
     if (dcp->nocwnd == 0) {
@@ -134,7 +697,15 @@ static uint64_t dcp_bbr_get_pacing_rate(DCPCB *dcp) {
 }
 
 static void dcp_bbr_on_pkt_sent(DCPCB *dcp, uint32_t bytes_sent) {
+    DCPBBRState *bbr = (DCPBBRState*)dcp->congestion_control_state;
+    if (bbr == NULL) return;
 
+    if (dcp->inflight_bytes == bytes_sent && dcp->app_limited) {
+        bbr->idle_restart = 1;
+        if (bbr->state == DCP_BBR_PROBE_BW) {
+            dcp_bbr_set_pacing_rate(dcp, bbr, bbr->btl_bw, DCP_BBR_UNIT);
+        }
+    }
 }
 
 static const struct dcp_cc_ops cc_bbr_ops = {
@@ -148,103 +719,612 @@ static const struct dcp_cc_ops cc_bbr_ops = {
 };
 
 static void dcp_flush_data(DCPCB *dcp, uint32_t now);
+static void dcp_ack_now(DCPCB *dcp, uint32_t now);
+static void dcp_ack_piggybacked(DCPCB *dcp);
+static void dcp_parse_data(DCPCB *dcp, DCPSEG *newseg, uint32_t now);
+
+static uint32_t dcp_wnd_unused(DCPCB *dcp) {
+    uint32_t used = dcp->rcv_queue_len + dcp->rcv_held_len;
+    if (used < dcp->rcv_wnd) {
+        return dcp->rcv_wnd - used;
+    }
+    return 0;
+}
 static void dcp_on_rto_timeout(DCPCB *dcp, uint32_t now);
+static void dcp_on_loss_timeout(DCPCB *dcp, uint32_t now);
+static void dcp_arm_loss_timer(DCPCB *dcp, uint32_t now);
 
-static void dcp_on_rto_timeout(DCPCB *dcp, uint32_t now) {
-    if (dcp->is_released) return;
-    dcp->rto_timer_armed = 0;
+static int dcp_snd_ring_reserve(DCPCB *dcp, uint32_t count) {
+    DCPSendRing *r = &dcp->snd_ring;
+    uint32_t cap = DCP_SND_RING_MIN;
+    while (cap < count) {
+        if (cap >= DCP_SND_RING_MAX) return -1;
+        cap <<= 1;
+    }
+    if (r->seg != NULL && cap <= r->mask + 1) {
+        return 0;
+    }
+
+    size_t bytes = (size_t)cap * (sizeof(DCPSEG*) + 7 * sizeof(uint32_t) + sizeof(uint8_t));
+    char *block = (char*)dcp_get_malloc()(bytes);
+    if (block == NULL) return -1;
+
+    DCPSendRing nr;
+    nr.mask = cap - 1;
+    nr.seg = (DCPSEG**)block;
+    nr.ts = (uint32_t*)(nr.seg + cap);
+    nr.resendts = nr.ts + cap;
+    nr.rto = nr.resendts + cap;
+    nr.xmit = nr.rto + cap;
+    nr.fastack = nr.xmit + cap;
+    nr.xnext = nr.fastack + cap;
+    nr.xprev = nr.xnext + cap;
+    nr.sacked = (uint8_t*)(nr.xprev + cap);
+    nr.xhead = r->xhead;
+    nr.xtail = r->xtail;
+    nr.xlen = r->xlen;
+    nr.rto_floor = r->rto_floor;
+
+    if (r->seg != NULL) {
+        for (uint32_t sn = dcp->snd_una; sn != dcp->snd_nxt; sn++) {
+            uint32_t i = sn & r->mask;
+            uint32_t j = sn & nr.mask;
+            nr.seg[j] = r->seg[i];
+            nr.ts[j] = r->ts[i];
+            nr.resendts[j] = r->resendts[i];
+            nr.rto[j] = r->rto[i];
+            nr.xmit[j] = r->xmit[i];
+            nr.fastack[j] = r->fastack[i];
+            nr.xnext[j] = r->xnext[i];
+            nr.xprev[j] = r->xprev[i];
+            nr.sacked[j] = r->sacked[i];
+        }
+        dcp_get_free()(r->seg);
+    }
+
+    *r = nr;
+    return 0;
+}
+
+static void dcp_snd_ring_link(DCPSendRing *r, uint32_t sn) {
+    uint32_t rto = r->rto[sn & r->mask];
+
+    if (r->xlen++ == 0) {
+        r->xhead = sn;
+        r->rto_floor = rto;
+    } else {
+        if (rto < r->rto_floor) r->rto_floor = rto;
+        r->xnext[r->xtail & r->mask] = sn;
+        r->xprev[sn & r->mask] = r->xtail;
+    }
+    r->xtail = sn;
+}
 
-    if (dcp->snd_buf_head.next == &dcp->snd_buf_head) {
+static void dcp_snd_ring_unlink(DCPSendRing *r, uint32_t sn) {
+    uint32_t i = sn & r->mask;
+    if (sn == r->xhead) {
+        r->xhead = r->xnext[i];
+    } else {
+        r->xnext[r->xprev[i] & r->mask] = r->xnext[i];
+    }
+    if (sn == r->xtail) {
+        r->xtail = r->xprev[i];
+    } else {
+        r->xprev[r->xnext[i] & r->mask] = r->xprev[i];
+    }
+    r->xlen--;
+}
+
+static void dcp_arm_rto_timer(DCPCB *dcp, uint32_t now) {
+    const DCPSendRing *r = &dcp->snd_ring;
+
+    if (r->xlen == 0) {
+        dcp_scheduler_cancel(dcp->scheduler, &dcp->rto_timer);
         return;
     }
 
-    DCPSEG *seg = dcp->snd_buf_head.next;
-    
-    dcp->rx_rto *= 2;
-    if (dcp->rx_rto > 60000) dcp->rx_rto = 60000;
-    
-    seg->rto = dcp->rx_rto;
-    seg->xmit++;
+    uint32_t sn = r->xhead;
+    uint32_t earliest = r->resendts[sn & r->mask];
+
+    for (uint32_t n = r->xlen - 1; n > 0; n--) {
+        sn = r->xnext[sn & r->mask];
+        uint32_t i = sn & r->mask;
+        if ((int32_t)(r->ts[i] + r->rto_floor - earliest) >= 0) break;
+        if ((int32_t)(r->resendts[i] - earliest) < 0) earliest = r->resendts[i];
+    }
+
+    if ((int32_t)(dcp->rto_restart_ts - earliest) > 0) {
+        earliest = dcp->rto_restart_ts;
+    }
+
+    uint32_t delay = (int32_t)(earliest - now) > 0 ? earliest - now : 0;
+    dcp_scheduler_reschedule(dcp->scheduler, &dcp->rto_timer, delay);
+}
+
+static void dcp_retransmit_seg(DCPCB *dcp, uint32_t sn, uint32_t now, uint32_t reason) {
+    DCPSendRing *r = &dcp->snd_ring;
+    uint32_t i = sn & r->mask;
+    DCPSEG *seg = r->seg[i];
+    uint64_t rate = dcp->cc_ops->get_pacing_rate(dcp);
+    uint64_t now_us = dcp_scheduler_now_us(dcp->scheduler);
+
+    r->xmit[i]++;
+    r->fastack[i] = 0;
+    r->ts[i] = now;
+    dcp_snd_ring_unlink(r, sn);
+    dcp_snd_ring_link(r, sn);
+    r->resendts[i] = now + r->rto[i];
     seg->ts = now;
-    seg->wnd = dcp->rcv_queue_len;
+    seg->wnd = dcp_wnd_unused(dcp);
     seg->una = dcp->rcv_nxt;
+    dcp_rate_on_sent(dcp, seg, now);
+    if (reason != DCP_TRACE_REASON_TLP) {
+        dcp->lost += seg->len + DCP_OVERHEAD;
+    }
+    DCP_STAT_INC(dcp->stats, segs_retrans);
+    DCP_STAT_ADD(dcp->stats, bytes_retrans, seg->len);
+    dcp_trace(dcp, DCP_TRACE_PKT_RETRANS, now, sn, seg->len, dcp->inflight_bytes, reason);
     
+    if (dcp->next_send_time_us < now_us) {
+        dcp->next_send_time_us = now_us;
+    }
+    if (rate > 0) {
+        dcp->next_send_time_us += (uint64_t)(seg->len + DCP_OVERHEAD) * 1000000 / rate;
+    }
+
     _dcp_output_seg(dcp, seg);
+    dcp_ack_piggybacked(dcp);
+}
+
+static void dcp_on_rto_timeout(DCPCB *dcp, uint32_t now) {
+    if (dcp->is_released) return;
+
+    DCPSendRing *r = &dcp->snd_ring;
+    uint32_t lost = 0;
+    uint32_t first_lost_sn = 0;
+
+    for (uint32_t sn = dcp->snd_una; sn != dcp->snd_nxt; sn++) {
+        uint32_t i = sn & r->mask;
+        if (!r->sacked[i] && (int32_t)(now - r->resendts[i]) >= 0) {
+            if (lost++ == 0) first_lost_sn = sn;
+
+            r->rto[i] *= 2;
+            if (r->rto[i] > DCP_RTO_MAX) r->rto[i] = DCP_RTO_MAX;
+            dcp_retransmit_seg(dcp, sn, now, DCP_TRACE_REASON_RTO);
+        }
+    }
     
-    if (dcp->cc_ops && dcp->cc_ops->on_loss) {
-        dcp->cc_ops->on_loss(dcp, seg->sn, now);
+    if (lost > 0) {
+        DCP_STAT_INC(dcp->stats, rto_timeouts);
+        dcp_trace(dcp, DCP_TRACE_RTO, now, first_lost_sn, lost, (uint64_t)dcp->rx_rto, 0);
+    }
+    if (lost > 0 && dcp->cc_ops && dcp->cc_ops->on_loss) {
+        dcp->cc_ops->on_loss(dcp, first_lost_sn, now);
     }
     
-    if (dcp->snd_buf_head.next != &dcp->snd_buf_head) {
-        dcp_scheduler_add(dcp->scheduler, dcp, dcp->rx_rto, dcp_on_rto_timeout);
-        dcp->rto_timer_armed = 1;
+    dcp_arm_rto_timer(dcp, now);
+}
+
+static int dcp_rcv_ring_reserve(DCPCB *dcp, uint32_t wnd) {
+    uint32_t cap = DCP_RCV_RING_MIN;
+    while (cap < wnd) {
+        if (cap >= DCP_RCV_RING_MAX) return -1;
+        cap <<= 1;
+    }
+    if (dcp->rcv_ring != NULL && cap <= dcp->rcv_ring_mask + 1) {
+        return 0;
+    }
+
+    DCPSEG **ring = (DCPSEG**)dcp_get_malloc()(cap * sizeof(DCPSEG*));
+    uint64_t *bits = (uint64_t*)dcp_get_malloc()((cap / 64) * sizeof(uint64_t));
+    if (ring == NULL || bits == NULL) {
+        if (ring) dcp_get_free()(ring);
+        if (bits) dcp_get_free()(bits);
+        return -1;
     }
+    memset(bits, 0, (cap / 64) * sizeof(uint64_t));
+
+    uint32_t mask = cap - 1;
+    if (dcp->rcv_ring != NULL) {
+        uint32_t old_cap = dcp->rcv_ring_mask + 1;
+        for (uint32_t i = 0; i < old_cap; i++) {
+            if (dcp->rcv_ring_bits[i >> 6] & (1ULL << (i & 63))) {
+                DCPSEG *seg = dcp->rcv_ring[i];
+                uint32_t slot = seg->sn & mask;
+                ring[slot] = seg;
+                bits[slot >> 6] |= 1ULL << (slot & 63);
+            }
+        }
+        dcp_get_free()(dcp->rcv_ring);
+        dcp_get_free()(dcp->rcv_ring_bits);
+    }
+
+    dcp->rcv_ring = ring;
+    dcp->rcv_ring_bits = bits;
+    dcp->rcv_ring_mask = mask;
+    return 0;
+}
+
+static inline int dcp_rcv_ring_test(const DCPCB *dcp, uint32_t sn) {
+    uint32_t slot = sn & dcp->rcv_ring_mask;
+    return (dcp->rcv_ring_bits[slot >> 6] >> (slot & 63)) & 1;
+}
+
+static uint32_t dcp_rcv_ring_scan(const DCPCB *dcp, uint32_t sn, uint32_t end, int occupied) {
+    while ((int32_t)(sn - end) < 0) {
+        uint32_t slot = sn & dcp->rcv_ring_mask;
+        uint32_t off = slot & 63;
+        uint64_t word = dcp->rcv_ring_bits[slot >> 6];
+        if (!occupied) word = ~word;
+        word >>= off;
+        if (word != 0) {
+            sn += (uint32_t)__builtin_ctzll(word);
+            return ((int32_t)(sn - end) < 0) ? sn : end;
+        }
+        sn += 64 - off;
+    }
+    return end;
+}
+
+static uint32_t dcp_rcv_ring_rscan(const DCPCB *dcp, uint32_t sn, uint32_t begin) {
+    while ((int32_t)(sn - begin) > 0) {
+        uint32_t slot = (sn - 1) & dcp->rcv_ring_mask;
+        uint32_t off = slot & 63;
+        uint64_t word = ~dcp->rcv_ring_bits[slot >> 6] << (63 - off);
+        if (word != 0) {
+            sn -= (uint32_t)__builtin_clzll(word);
+            return ((int32_t)(sn - begin) > 0) ? sn : begin;
+        }
+        sn -= off + 1;
+    }
+    return begin;
+}
+
+static uint32_t dcp_encode_sack(DCPCB *dcp, char *ptr) {
+    uint32_t blocks = 0;
+    uint32_t end = dcp->rcv_nxt + dcp->rcv_ring_mask + 1;
+    uint32_t sn = dcp->rcv_nxt;
+    uint32_t latest = dcp->ack_latest_sn;
+    uint32_t first = end;
+
+    if (dcp->rcv_buf_len > 0 && latest - dcp->rcv_nxt - 1 < dcp->rcv_ring_mask &&
+        dcp_rcv_ring_test(dcp, latest)) {
+        first = dcp_rcv_ring_rscan(dcp, latest, dcp->rcv_nxt);
+        _dcp_encode_32u(ptr, first); ptr += 4;
+        _dcp_encode_32u(ptr, dcp_rcv_ring_scan(dcp, latest, end, 0)); ptr += 4;
+        blocks++;
+    }
+
+    while (dcp->rcv_buf_len > 0 && blocks < DCP_SACK_MAX_BLOCKS) {
+        uint32_t start = dcp_rcv_ring_scan(dcp, sn, end, 1);
+        if (start == end) break;
+        sn = dcp_rcv_ring_scan(dcp, start, end, 0);
+        if (start == first) continue;
+        _dcp_encode_32u(ptr, start); ptr += 4;
+        _dcp_encode_32u(ptr, sn);    ptr += 4;
+        blocks++;
+    }
+
+    return blocks * DCP_SACK_BLOCK_SIZE;
 }
 
 static void dcp_on_ack_delay_timeout(DCPCB *dcp, uint32_t now) {
+    (void)now;
     if (dcp->is_released) return;
     dcp->ack_delayed_until = 0;
     
-    DCPSEG ack_seg;
-    memset(&ack_seg, 0, sizeof(DCPSEG));
-    ack_seg.conv_id = dcp->conv_id;
-    ack_seg.cmd = DCP_CMD_ACK;
-    ack_seg.wnd = dcp->rcv_queue_len;
-    ack_seg.una = dcp->rcv_nxt;
+    DCPSEG *ack_seg = dcp_seg_create(dcp, DCP_SACK_MAX_BLOCKS * DCP_SACK_BLOCK_SIZE);
+    if (ack_seg == NULL) return;
+
+    ack_seg->conv_id = dcp->conv_id;
+    ack_seg->cmd = DCP_CMD_ACK;
+    ack_seg->wnd = dcp_wnd_unused(dcp);
+    ack_seg->una = dcp->rcv_nxt;
+    ack_seg->ts = dcp->ack_ts_echo;
+    ack_seg->sn = dcp->ack_latest_sn;
+    ack_seg->len = dcp_encode_sack(dcp, ack_seg->data);
+    dcp->ack_count = 0;
+    DCP_STAT_INC(dcp->stats, acks_sent);
     
-    _dcp_output_seg(dcp, &ack_seg);
+    _dcp_output_seg(dcp, ack_seg);
+    dcp_seg_free(dcp, ack_seg);
 }
 
-static void dcp_flush_data(DCPCB *dcp, uint32_t now) {
-    if (dcp->is_released) return;
-    dcp->pacing_timer_armed = 0;
+static void dcp_ack_now(DCPCB *dcp, uint32_t now) {
+    dcp_scheduler_cancel(dcp->scheduler, &dcp->ack_timer);
+    dcp_on_ack_delay_timeout(dcp, now);
+}
 
-    if (dcp->snd_queue_head.next == &dcp->snd_queue_head) {
-        return;
+static void dcp_ack_piggybacked(DCPCB *dcp) {
+    if (dcp->ack_count == 0 || dcp->rcv_buf_len > 0) return;
+
+    dcp_scheduler_cancel(dcp->scheduler, &dcp->ack_timer);
+    dcp->ack_delayed_until = 0;
+    dcp->ack_count = 0;
+}
+
+static int dcp_data_due(DCPCB *dcp, uint32_t within_ms) {
+    if (dcp->snd_queue_head.next == &dcp->snd_queue_head) return 0;
+
+    if (!dcp_cwnd_open(dcp, 0)) return 0;
+
+    uint64_t now_us = dcp_scheduler_now_us(dcp->scheduler);
+    return dcp->next_send_time_us <= now_us + (uint64_t)within_ms * 1000;
+}
+
+static void dcp_send_ackfreq(DCPCB *dcp, uint32_t seq, int echo, uint32_t now) {
+    DCPSEG *seg = dcp_seg_create(dcp, DCP_ACKFREQ_SIZE);
+    if (seg == NULL) return;
+
+    seg->conv_id = dcp->conv_id;
+    seg->cmd = DCP_CMD_ACKFREQ;
+    seg->wnd = dcp_wnd_unused(dcp);
+    seg->una = dcp->rcv_nxt;
+    seg->ts = now;
+    seg->sn = dcp->snd_nxt;
+    _dcp_encode_32u(seg->data, seq);
+    if (echo) {
+        seg->len = 4;
+    } else {
+        _dcp_encode_32u(seg->data + 4, dcp->ack_freq_req_pkts);
+        _dcp_encode_32u(seg->data + 8, dcp->ack_freq_req_delay);
+        dcp->ack_freq_req_ts = now;
     }
-    
-    uint32_t cwnd_pkts = dcp->cc_ops->get_cwnd(dcp) / dcp->mss;
-    if (cwnd_pkts == 0) cwnd_pkts = 1;
 
-    if (dcp->snd_buf_len >= cwnd_pkts) {
+    _dcp_output_seg(dcp, seg);
+    dcp_seg_free(dcp, seg);
+}
+
+static void dcp_parse_ackfreq(DCPCB *dcp, const char *ptr, uint32_t len, uint32_t now) {
+    uint32_t seq;
+
+    if (len < 4) return;
+    _dcp_decode_32u(ptr, &seq);
+
+    if (len < DCP_ACKFREQ_SIZE) {
+        if (dcp->ack_freq_req_pending && seq == dcp->ack_freq_req_seq) {
+            dcp->ack_freq_req_pending = 0;
+            dcp->peer_ack_delay = dcp->ack_freq_req_delay;
+        }
         return;
     }
-    
+
+    if ((int32_t)(seq - dcp->ack_freq_seq) > 0) {
+        uint32_t pkts, delay;
+        _dcp_decode_32u(ptr + 4, &pkts);
+        _dcp_decode_32u(ptr + 8, &delay);
+        dcp->ack_freq_seq = seq;
+        dcp->ack_freq = pkts;
+        dcp->ack_max_delay = delay;
+    }
+    dcp_send_ackfreq(dcp, seq, 1, now);
+}
+
+static void dcp_fec_emit(DCPCB *dcp, uint32_t now) {
+    DCPFecEncoder *enc = dcp->fec_enc;
+    if (enc->count == 0) return;
+
+    uint64_t rate = dcp->cc_ops->get_pacing_rate(dcp);
+    for (uint32_t j = 0; j < enc->m; j++) {
+        DCPSEG *seg = dcp_seg_create(dcp, DCP_FEC_HDR + enc->sym_len);
+        if (seg == NULL) break;
+
+        seg->conv_id = dcp->conv_id;
+        seg->cmd = DCP_CMD_FEC;
+        seg->sn = enc->base_sn;
+        seg->ts = now;
+        seg->wnd = dcp_wnd_unused(dcp);
+        seg->una = dcp->rcv_nxt;
+        seg->data[0] = (char)enc->count;
+        seg->data[1] = (char)enc->m;
+        seg->data[2] = (char)j;
+        seg->data[3] = 0;
+        memcpy(seg->data + DCP_FEC_HDR, dcp_fec_encoder_parity(enc, j), enc->sym_len);
+
+        if (_dcp_output_seg(dcp, seg) >= 0) {
+            DCP_STAT_INC(dcp->stats, fec_parity_sent);
+        }
+        if (rate > 0) {
+            dcp->next_send_time_us += (uint64_t)(seg->len + DCP_OVERHEAD) * 1000000 / rate;
+        }
+        dcp_seg_free(dcp, seg);
+    }
+    dcp_fec_encoder_reset(enc);
+}
+
+static void dcp_fec_on_sent(DCPCB *dcp, const DCPSEG *seg, uint32_t now) {
+    int ret = dcp_fec_encode(dcp->fec_enc, seg->sn, seg->frg, seg->data, seg->len);
+    if (ret == -3) {
+        dcp_fec_emit(dcp, now);
+        ret = dcp_fec_encode(dcp->fec_enc, seg->sn, seg->frg, seg->data, seg->len);
+    }
+    if (ret == 1) {
+        dcp_fec_emit(dcp, now);
+    }
+}
+
+static int dcp_fec_recover_group(DCPCB *dcp, int group, uint32_t now) {
+    uint32_t base = 0;
+    uint32_t mask = dcp_fec_decoder_recover(dcp->fec_dec, group, &base);
+    int recovered = 0;
+
+    for (uint32_t i = 0; mask != 0; i++, mask >>= 1) {
+        if ((mask & 1) == 0) continue;
+
+        uint32_t sn = base + i;
+        if (sn - dcp->rcv_nxt >= dcp->rcv_wnd || sn - dcp->rcv_nxt > dcp->rcv_ring_mask ||
+            dcp_rcv_ring_test(dcp, sn)) {
+            continue;
+        }
+
+        uint32_t frg = 0, len = 0;
+        const uint8_t *data = dcp_fec_decoder_lookup(dcp->fec_dec, sn, &frg, &len);
+        if (data == NULL) continue;
+
+        DCPSEG *newseg = dcp_seg_create(dcp, len);
+        if (newseg == NULL) break;
+
+        newseg->conv_id = dcp->conv_id;
+        newseg->cmd = DCP_CMD_PUSH;
+        newseg->frg = frg;
+        newseg->ts = now;
+        newseg->sn = sn;
+        newseg->una = dcp->snd_una;
+        if (len > 0) {
+            memcpy(newseg->data, data, len);
+        }
+
+        dcp_parse_data(dcp, newseg, now);
+        DCP_STAT_INC(dcp->stats, fec_recovered);
+        recovered++;
+    }
+    return recovered;
+}
+
+static DCPSEG* dcp_send_new_seg(DCPCB *dcp, uint32_t now) {
+    if (dcp_snd_ring_reserve(dcp, dcp->snd_buf_len + 1) < 0) {
+        return NULL;
+    }
+
     DCPSEG *seg = dcp->snd_queue_head.next;
     list_del_seg(seg);
     dcp->snd_queue_len--;
+    if (seg == dcp->stream_tail) {
+        dcp->stream_tail = NULL;
+    }
     
-    list_add_tail_seg(&dcp->snd_buf_head, seg);
+    DCPSendRing *r = &dcp->snd_ring;
+    uint32_t i = dcp->snd_nxt & r->mask;
+    r->seg[i] = seg;
+    r->ts[i] = now;
+    r->rto[i] = dcp->rx_rto;
+    r->resendts[i] = now + dcp->rx_rto;
+    r->xmit[i] = 1;
+    r->fastack[i] = 0;
+    r->sacked[i] = 0;
+    dcp_snd_ring_link(r, dcp->snd_nxt);
     dcp->snd_buf_len++;
     
+    seg->conv_id = dcp->conv_id;
+    seg->cmd = DCP_CMD_PUSH;
     seg->sn = dcp->snd_nxt++;
     seg->ts = now;
-    seg->wnd = dcp->rcv_queue_len;
+    seg->wnd = dcp_wnd_unused(dcp);
     seg->una = dcp->rcv_nxt;
-    seg->rto = dcp->rx_rto;
-    seg->xmit = 1;
+    dcp_rate_on_sent(dcp, seg, now);
+    dcp->inflight_bytes += seg->len + DCP_OVERHEAD;
+    DCP_STAT_INC(dcp->stats, segs_sent);
+    DCP_STAT_ADD(dcp->stats, bytes_sent, seg->len);
+    dcp_trace(dcp, DCP_TRACE_PKT_SENT, now, seg->sn, seg->len, dcp->inflight_bytes, 0);
     
     _dcp_output_seg(dcp, seg);
+    if (dcp->fec_enc) {
+        dcp_fec_on_sent(dcp, seg, now);
+    }
+    dcp_ack_piggybacked(dcp);
     
     if (dcp->cc_ops && dcp->cc_ops->on_pkt_sent) {
         dcp->cc_ops->on_pkt_sent(dcp, seg->len + DCP_OVERHEAD);
     }
+    return seg;
+}
+
+static int dcp_stream_corked(const DCPCB *dcp, uint64_t now_us) {
+    const DCPSEG *seg = dcp->snd_queue_head.next;
+    return seg == dcp->stream_tail && seg->len < dcp->mss && dcp->snd_buf_len > 0 &&
+           dcp->stream_deadline_us > now_us;
+}
+
+static void dcp_flush_data(DCPCB *dcp, uint32_t now) {
+    if (dcp->is_released) return;
+
+    if (dcp->snd_queue_head.next == &dcp->snd_queue_head) {
+        dcp_rate_check_app_limited(dcp);
+        if (dcp->fec_enc) {
+            dcp_fec_emit(dcp, now);
+        }
+        return;
+    }
+
+    uint64_t now_us = dcp_scheduler_now_us(dcp->scheduler);
+    if (dcp->next_send_time_us > now_us) {
+        DCP_STAT_INC(dcp->stats, pacing_limited);
+        if (dcp->trace) {
+            dcp_trace(dcp, DCP_TRACE_PACING, now, (uint32_t)(dcp->next_send_time_us - now_us), 0,
+                      dcp->cc_ops->get_pacing_rate(dcp), 0);
+        }
+        dcp_scheduler_add_us(dcp->scheduler, &dcp->pacing_timer, dcp->next_send_time_us - now_us);
+        return;
+    }
     
-    if (dcp->rto_timer_armed == 0) {
-        dcp_scheduler_add(dcp->scheduler, dcp, dcp->rx_rto, dcp_on_rto_timeout);
-        dcp->rto_timer_armed = 1;
+    if (!dcp_cwnd_open(dcp, 0)) {
+        DCP_STAT_INC(dcp->stats, cwnd_limited);
+        return;
     }
 
-    if (dcp->snd_queue_head.next != &dcp->snd_queue_head) {
+    uint32_t burst = (dcp->pacing_burst > 1) ? dcp->pacing_burst : 1;
+    if (burst == 1 && dcp->next_send_time_us + DCP_TIMER_TICK_US < now_us) {
+        dcp->next_send_time_us = now_us - DCP_TIMER_TICK_US;
+    }
+
+    DCPPacket batch[DCP_BATCH_MAX];
+    if (dcp->output_batch) {
+        dcp->batch = batch;
+        dcp->batch_count = 0;
+    }
+
+    uint32_t sent = 0;
+    int corked = 0;
+    while (sent < burst && dcp->snd_queue_head.next != &dcp->snd_queue_head &&
+           dcp_cwnd_open(dcp, 0) && dcp->next_send_time_us <= now_us) {
+        if (dcp_stream_corked(dcp, now_us)) {
+            corked = 1;
+            break;
+        }
+        DCPSEG *seg = dcp_send_new_seg(dcp, now);
+        if (seg == NULL) break;
+
         uint64_t rate = dcp->cc_ops->get_pacing_rate(dcp);
-        uint32_t delay_ms = 1;
         if (rate > 0) {
-            delay_ms = (uint32_t)((seg->len + DCP_OVERHEAD) * 1000 / rate);
-            if (delay_ms == 0) delay_ms = 1;
+            dcp->next_send_time_us += (uint64_t)(seg->len + DCP_OVERHEAD) * 1000000 / rate;
+        } else {
+            dcp->next_send_time_us += 1000;
         }
-        
-        dcp_scheduler_add(dcp->scheduler, dcp, delay_ms, dcp_flush_data);
-        dcp->pacing_timer_armed = 1;
+        sent++;
+    }
+
+    if (dcp->fec_enc && dcp->snd_queue_head.next == &dcp->snd_queue_head) {
+        dcp_fec_emit(dcp, now);
+    }
+
+    if (dcp->batch) {
+        dcp_batch_flush(dcp);
+        dcp->batch = NULL;
+    }
+    
+    if (sent > 0 || !dcp_timer_pending(&dcp->rto_timer)) {
+        dcp_arm_rto_timer(dcp, now);
+    }
+    if (sent > 0) {
+        dcp_arm_loss_timer(dcp, now);
+    }
+
+    if (dcp->next_send_time_us < now_us) {
+        dcp->next_send_time_us = now_us;
+    }
+
+    if (dcp->snd_queue_head.next != &dcp->snd_queue_head) {
+        uint64_t due = dcp->next_send_time_us;
+        if (corked && dcp->stream_deadline_us > due) {
+            due = dcp->stream_deadline_us;
+        }
+        if (dcp->trace) {
+            dcp_trace(dcp, DCP_TRACE_PACING, now, (uint32_t)(due - now_us), sent,
+                      dcp->cc_ops->get_pacing_rate(dcp), 0);
+        }
+        dcp_scheduler_add_us(dcp->scheduler, &dcp->pacing_timer, due - now_us);
+    } else {
+        dcp_rate_check_app_limited(dcp);
     }
 }
 
@@ -276,11 +1356,33 @@ DCPCB* dcp_create(uint32_t conv_id, uint32_t token, void *user,
     dcp->rcv_wnd = 128;
     dcp->rmt_wnd = 128;
     dcp->fastresend = 2;
+    dcp->pacing_burst = 1;
+    dcp->ack_freq = DCP_ACK_FREQ_DEF;
+    dcp->ack_max_delay = DCP_ACK_DELAY_MS;
+    dcp->peer_ack_delay = DCP_ACK_DELAY_MS;
+
+    dcp_timer_init(&dcp->rto_timer, dcp, dcp_on_rto_timeout);
+    dcp_timer_init(&dcp->pacing_timer, dcp, dcp_flush_data);
+    dcp_timer_init(&dcp->ack_timer, dcp, dcp_on_ack_delay_timeout);
+    dcp_timer_init(&dcp->loss_timer, dcp, dcp_on_loss_timeout);
+    dcp->rack_rtt = -1;
+    dcp->rack_min_rtt = -1;
+    dcp->rack_reo_mult = 1;
     
     list_init_seg_head(&dcp->snd_queue_head);
     list_init_seg_head(&dcp->rcv_queue_head);
-    list_init_seg_head(&dcp->snd_buf_head);
-    list_init_seg_head(&dcp->rcv_buf_head);
+    list_init_seg_head(&dcp->rcv_held_head);
+
+    if (dcp_rcv_ring_reserve(dcp, dcp->rcv_wnd) < 0) {
+        dcp_get_free()(dcp);
+        return NULL;
+    }
+    if (dcp_snd_ring_reserve(dcp, dcp->snd_wnd) < 0) {
+        dcp_get_free()(dcp->rcv_ring);
+        dcp_get_free()(dcp->rcv_ring_bits);
+        dcp_get_free()(dcp);
+        return NULL;
+    }
 
     dcp_set_congestion_control(dcp, "bbr");
     
@@ -297,51 +1399,217 @@ static void dcp_flush_queue(DCPCB *dcp, struct DCPSEG *head) {
     list_init_seg_head(head);
 }
 
-void dcp_release(DCPCB *dcp) {
-    if (dcp == NULL || dcp->is_released) return;
+void dcp_release(DCPCB *dcp) {
+    if (dcp == NULL || dcp->is_released) return;
+
+    dcp->is_released = 1;
+
+    if (dcp->on_release) {
+        dcp->on_release(dcp);
+    }
+
+    dcp_scheduler_cancel(dcp->scheduler, &dcp->rto_timer);
+    dcp_scheduler_cancel(dcp->scheduler, &dcp->pacing_timer);
+    dcp_scheduler_cancel(dcp->scheduler, &dcp->ack_timer);
+    dcp_scheduler_cancel(dcp->scheduler, &dcp->loss_timer);
+
+    if (dcp->cc_ops && dcp->cc_ops->release) {
+        dcp->cc_ops->release(dcp);
+    }
+
+    dcp_flush_queue(dcp, &dcp->snd_queue_head);
+    dcp_flush_queue(dcp, &dcp->rcv_queue_head);
+    for (uint32_t sn = dcp->snd_una; sn != dcp->snd_nxt; sn++) {
+        dcp_seg_free(dcp, dcp->snd_ring.seg[sn & dcp->snd_ring.mask]);
+    }
+    dcp_get_free()(dcp->snd_ring.seg);
+    dcp_flush_queue(dcp, &dcp->rcv_held_head);
+
+    for (uint32_t i = 0; i <= dcp->rcv_ring_mask; i++) {
+        if (dcp->rcv_ring_bits[i >> 6] & (1ULL << (i & 63))) {
+            dcp_seg_free(dcp, dcp->rcv_ring[i]);
+        }
+    }
+    dcp_get_free()(dcp->rcv_ring);
+    dcp_get_free()(dcp->rcv_ring_bits);
+
+    dcp_fec_encoder_release(dcp->fec_enc);
+    dcp_fec_decoder_release(dcp->fec_dec);
+    
+    dcp_get_free()(dcp);
+}
+
+void dcp_set_output(DCPCB *dcp, dcp_output_callback output) {
+    if (dcp) dcp->output = output;
+}
+
+void dcp_set_outputv(DCPCB *dcp, dcp_outputv_callback outputv) {
+    if (dcp) dcp->outputv = outputv;
+}
+
+void dcp_set_output_batch(DCPCB *dcp, dcp_output_batch_callback output_batch) {
+    if (dcp) dcp->output_batch = output_batch;
+}
+
+int dcp_set_pacing_burst(DCPCB *dcp, int max_burst) {
+    if (dcp == NULL || max_burst < 1) return -1;
+    dcp->pacing_burst = (max_burst > DCP_BATCH_MAX) ? DCP_BATCH_MAX : (uint32_t)max_burst;
+    return 0;
+}
+
+int dcp_set_congestion_control(DCPCB *dcp, const char *algo_name) {
+    if (dcp == NULL || algo_name == NULL) return -1;
+    
+    if (dcp->cc_ops && dcp->cc_ops->release) {
+        dcp->cc_ops->release(dcp);
+    }
+    
+    if (strcmp(algo_name, "bbr") == 0) {
+        dcp->cc_ops = &cc_bbr_ops;
+        dcp->cc_ops->init(dcp);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int dcp_fec_setup(DCPCB *dcp, uint32_t k, uint32_t m) {
+    DCPFecEncoder *enc = NULL;
+    DCPFecDecoder *dec = NULL;
+    uint32_t mss = dcp->mtu - DCP_OVERHEAD;
+    int ret = 0;
+
+    if (k > 0) {
+        if (m > 0) {
+            enc = dcp_fec_encoder_create(k, m, mss - DCP_FEC_HDR);
+        }
+        dec = dcp_fec_decoder_create(mss - DCP_FEC_HDR, 4 * DCP_FEC_MAX_DATA);
+        if ((m > 0 && enc == NULL) || dec == NULL) {
+            dcp_fec_encoder_release(enc);
+            dcp_fec_decoder_release(dec);
+            enc = NULL;
+            dec = NULL;
+            k = m = 0;
+            ret = -3;
+        }
+    }
+
+    dcp_fec_encoder_release(dcp->fec_enc);
+    dcp_fec_decoder_release(dcp->fec_dec);
+    dcp->fec_enc = enc;
+    dcp->fec_dec = dec;
+    dcp->fec_k = k;
+    dcp->fec_m = m;
+    dcp->mss = (k > 0) ? mss - DCP_FEC_OVERHEAD : mss;
+    dcp->stream_tail = NULL;
+    return ret;
+}
+
+int dcp_setmtu(DCPCB *dcp, int mtu) {
+    if (dcp == NULL || mtu < (DCP_OVERHEAD + 1)) return -1;
+    if (dcp->fec_k > 0 && mtu < (DCP_OVERHEAD + DCP_FEC_OVERHEAD + 1)) return -1;
+    dcp->mtu = mtu;
+    dcp->mss = dcp->mtu - DCP_OVERHEAD;
+    dcp->stream_tail = NULL;
+    if (dcp->fec_k > 0) {
+        return dcp_fec_setup(dcp, dcp->fec_k, dcp->fec_m);
+    }
+    return 0;
+}
+
+int dcp_set_fec(DCPCB *dcp, int k, int m) {
+    if (dcp == NULL || k < 0 || k > DCP_FEC_MAX_DATA || m < 0 || m > DCP_FEC_MAX_PARITY) return -1;
+    if (k > 0 && dcp->mtu < DCP_OVERHEAD + DCP_FEC_OVERHEAD + 1) return -2;
+    return dcp_fec_setup(dcp, (uint32_t)k, (k > 0) ? (uint32_t)m : 0);
+}
+
+int dcp_set_stream(DCPCB *dcp, int enable, int cork_ms) {
+    if (dcp == NULL || cork_ms < 0) return -1;
+    if (!enable && dcp->rcv_stream_off != 0) return -2;
+
+    dcp->stream = enable ? 1 : 0;
+    dcp->stream_cork_ms = (uint32_t)cork_ms;
+    dcp->stream_tail = NULL;
+    dcp->stream_deadline_us = 0;
+    return 0;
+}
+
+int dcp_stream_flush(DCPCB *dcp) {
+    if (dcp == NULL || dcp->is_released) return -1;
+    if (dcp->stream_tail == NULL) return 0;
+
+    dcp->stream_deadline_us = 0;
+    dcp_scheduler_add(dcp->scheduler, &dcp->pacing_timer, 0);
+    return 0;
+}
+
+int dcp_set_compact_header(DCPCB *dcp, int enable) {
+    if (dcp == NULL) return -1;
+    dcp->hdr_compact = enable ? 1 : 0;
+    return 0;
+}
 
-    dcp->is_released = 1;
+int dcp_set_ack_frequency(DCPCB *dcp, int pkts, int max_delay_ms) {
+    if (dcp == NULL || pkts < 0 || max_delay_ms < 0) return -1;
+    dcp->ack_freq = pkts;
+    dcp->ack_max_delay = max_delay_ms;
+    return 0;
+}
 
-    if (dcp->cc_ops && dcp->cc_ops->release) {
-        dcp->cc_ops->release(dcp);
+int dcp_request_ack_frequency(DCPCB *dcp, int pkts, int max_delay_ms, uint32_t now) {
+    if (dcp == NULL || dcp->is_released || pkts < 0 || max_delay_ms < 0) return -1;
+    dcp->ack_freq_req_seq++;
+    dcp->ack_freq_req_pkts = pkts;
+    dcp->ack_freq_req_delay = max_delay_ms;
+    dcp->ack_freq_req_pending = 1;
+    if ((uint32_t)max_delay_ms > dcp->peer_ack_delay) {
+        dcp->peer_ack_delay = max_delay_ms;
     }
-
-    dcp_flush_queue(dcp, &dcp->snd_queue_head);
-    dcp_flush_queue(dcp, &dcp->rcv_queue_head);
-    dcp_flush_queue(dcp, &dcp->snd_buf_head);
-    dcp_flush_queue(dcp, &dcp->rcv_buf_head);
-    
-    dcp_get_free()(dcp);
+    dcp_send_ackfreq(dcp, dcp->ack_freq_req_seq, 0, now);
+    return 0;
 }
 
-void dcp_set_output(DCPCB *dcp, dcp_output_callback output) {
-    if (dcp) dcp->output = output;
+int dcp_set_trace(DCPCB *dcp, int enable) {
+    if (dcp == NULL) return -1;
+    dcp->trace = enable ? 1 : 0;
+    return 0;
 }
 
-int dcp_set_congestion_control(DCPCB *dcp, const char *algo_name) {
-    if (dcp == NULL || algo_name == NULL) return -1;
-    
-    if (dcp->cc_ops && dcp->cc_ops->release) {
-        dcp->cc_ops->release(dcp);
-    }
-    
-    if (strcmp(algo_name, "bbr") == 0) {
-        dcp->cc_ops = &cc_bbr_ops;
-        dcp->cc_ops->init(dcp);
-    } else {
-        return -1;
-    }
+int dcp_get_stats(DCPCB *dcp, DCPStats *stats) {
+    if (dcp == NULL || stats == NULL) return -1;
+
+    *stats = dcp->stats;
+    stats->srtt = dcp->rx_srtt;
+    stats->rttvar = dcp->rx_rttval;
+    stats->rto = dcp->rx_rto;
+    stats->min_rtt = dcp->rack_min_rtt;
+    stats->cwnd = (dcp->cc_ops && dcp->cc_ops->get_cwnd) ? dcp->cc_ops->get_cwnd(dcp) : 0;
+    stats->inflight_bytes = dcp->inflight_bytes;
+    stats->pacing_rate = (dcp->cc_ops && dcp->cc_ops->get_pacing_rate) ?
+                         dcp->cc_ops->get_pacing_rate(dcp) : 0;
+    stats->snd_queue_len = dcp->snd_queue_len;
+    stats->snd_buf_len = dcp->snd_buf_len;
+    stats->rcv_queue_len = dcp->rcv_queue_len;
+    stats->rcv_buf_len = dcp->rcv_buf_len;
     return 0;
 }
 
-int dcp_setmtu(DCPCB *dcp, int mtu) {
-    if (dcp == NULL || mtu < (DCP_OVERHEAD + 1)) return -1;
-    dcp->mtu = mtu;
-    dcp->mss = dcp->mtu - DCP_OVERHEAD;
+int dcp_wndsize(DCPCB *dcp, int sndwnd, int rcvwnd) {
+    if (dcp == NULL) return -1;
+    if (sndwnd > 0) {
+        dcp->snd_wnd = sndwnd;
+    }
+    if (rcvwnd > 0) {
+        if (dcp_rcv_ring_reserve(dcp, rcvwnd) < 0) return -2;
+        dcp->rcv_wnd = rcvwnd;
+    }
     return 0;
 }
 
 static void dcp_update_rtt(DCPCB *dcp, int32_t rtt) {
+    if (dcp->rack_min_rtt < 0 || rtt < dcp->rack_min_rtt) {
+        dcp->rack_min_rtt = rtt;
+    }
     if (dcp->rx_srtt == 0) {
         dcp->rx_srtt = rtt;
         dcp->rx_rttval = rtt / 2;
@@ -355,99 +1623,326 @@ static void dcp_update_rtt(DCPCB *dcp, int32_t rtt) {
     dcp->rx_rto = (rto < dcp->rx_minrto) ? dcp->rx_minrto : rto;
 }
 
-static void dcp_parse_una(DCPCB *dcp, uint32_t una) {
-    DCPSEG *node = dcp->snd_buf_head.next;
-    while(node != &dcp->snd_buf_head) {
-        if (node->sn < una) {
-            DCPSEG *to_free = node;
-            node = node->next;
-            list_del_seg(to_free);
-            dcp_seg_free(dcp, to_free);
-            dcp->snd_buf_len--;
-        } else {
-            break;
+static void dcp_snd_delivered(DCPCB *dcp, uint32_t sn, uint32_t now) {
+    DCPSendRing *r = &dcp->snd_ring;
+    uint32_t i = sn & r->mask;
+    uint32_t ts = r->ts[i];
+    int32_t rtt = (int32_t)(now - ts);
+
+    dcp_rate_on_delivered(dcp, r->seg[i], r->xmit[i], now);
+
+    if (r->xmit[i] > 1 && dcp->rack_min_rtt >= 0 && rtt < dcp->rack_min_rtt) {
+        DCP_STAT_INC(dcp->stats, spurious_retrans);
+        if (now - dcp->rack_reo_ts >= (uint32_t)dcp->rx_srtt &&
+            dcp->rack_reo_mult < DCP_RACK_REO_MULT_MAX) {
+            dcp->rack_reo_mult++;
+            dcp->rack_reo_ts = now;
+        }
+        dcp->rack_reo_persist = DCP_RACK_REO_PERSIST;
+        return;
+    }
+
+    if (dcp->rack_rtt < 0 || (int32_t)(ts - dcp->rack_xmit_ts) > 0 ||
+        (ts == dcp->rack_xmit_ts && (int32_t)(sn - dcp->rack_sn) > 0)) {
+        dcp->rack_xmit_ts = ts;
+        dcp->rack_sn = sn;
+        dcp->rack_rtt = rtt;
+    }
+}
+
+static void dcp_parse_una(DCPCB *dcp, uint32_t una, uint32_t now) {
+    DCPSendRing *r = &dcp->snd_ring;
+
+    if ((int32_t)(una - dcp->snd_nxt) > 0) una = dcp->snd_nxt;
+
+    while ((int32_t)(una - dcp->snd_una) > 0) {
+        uint32_t i = dcp->snd_una & r->mask;
+        if (!r->sacked[i]) {
+            dcp_snd_ring_unlink(r, dcp->snd_una);
+            dcp_trace(dcp, DCP_TRACE_PKT_ACKED, now, dcp->snd_una, now - r->ts[i],
+                      dcp->inflight_bytes, 0);
+            dcp_snd_delivered(dcp, dcp->snd_una, now);
         }
+        dcp_seg_free(dcp, r->seg[i]);
+        dcp->snd_buf_len--;
+        dcp->snd_una++;
     }
-    dcp->snd_una = una;
 }
 
-static void dcp_parse_fastack(DCPCB *dcp, uint32_t sn) {
-    DCPSEG *node = dcp->snd_buf_head.next;
-    while(node != &dcp->snd_buf_head) {
-        if (node->sn < sn) {
-            node = node->next;
-        } else if (node->sn == sn) {
-            node->fastack++;
-            break;
-        } else {
-            break;
+static uint32_t dcp_parse_sack(DCPCB *dcp, const char *ptr, uint32_t len, uint32_t highest,
+                               uint32_t now) {
+    DCPSendRing *r = &dcp->snd_ring;
+    uint32_t blocks = len / DCP_SACK_BLOCK_SIZE;
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t start, end;
+        _dcp_decode_32u(ptr, &start); ptr += 4;
+        _dcp_decode_32u(ptr, &end);   ptr += 4;
+        if ((int32_t)(end - start) <= 0) continue;
+        if ((int32_t)(end - highest) > 0) highest = end;
+
+        if ((int32_t)(start - dcp->snd_una) < 0) start = dcp->snd_una;
+        if ((int32_t)(end - dcp->snd_nxt) > 0) end = dcp->snd_nxt;
+
+        for (uint32_t sn = start; (int32_t)(sn - end) < 0; sn++) {
+            uint32_t i = sn & r->mask;
+            if (!r->sacked[i]) {
+                r->sacked[i] = 1;
+                dcp_snd_ring_unlink(r, sn);
+                dcp_trace(dcp, DCP_TRACE_PKT_SACKED, now, sn, now - r->ts[i],
+                          dcp->inflight_bytes, 0);
+                dcp_snd_delivered(dcp, sn, now);
+            }
+        }
+    }
+    return highest;
+}
+
+static void dcp_parse_fastack(DCPCB *dcp, uint32_t maxsn) {
+    DCPSendRing *r = &dcp->snd_ring;
+
+    if (dcp->fastresend == 0 || dcp->rack_rtt >= 0) return;
+
+    if ((int32_t)(maxsn - dcp->snd_nxt) > 0) maxsn = dcp->snd_nxt;
+
+    for (uint32_t sn = dcp->snd_una; (int32_t)(sn - maxsn) < 0; sn++) {
+        uint32_t i = sn & r->mask;
+        if (!r->sacked[i] && r->xmit[i] == 1) {
+            r->fastack[i]++;
+        }
+    }
+}
+
+static int dcp_rack_sent_before(const DCPCB *dcp, uint32_t sn, uint32_t ts) {
+    if ((int32_t)(dcp->rack_xmit_ts - ts) > 0) return 1;
+    return ts == dcp->rack_xmit_ts && (int32_t)(sn - dcp->rack_sn) < 0;
+}
+
+static void dcp_detect_loss(DCPCB *dcp, uint32_t now) {
+    int32_t reo_wnd = (dcp->rack_min_rtt > 0) ? dcp->rack_min_rtt / 4 : 1;
+    int32_t wait = -1;
+    uint32_t lost = 0;
+    uint32_t first_lost_sn = 0;
+    int dupthresh = (dcp->fastresend > 0 && dcp->rack_rtt < 0);
+
+    reo_wnd *= (int32_t)dcp->rack_reo_mult;
+    if (dcp->rx_srtt > 0 && reo_wnd > dcp->rx_srtt) reo_wnd = dcp->rx_srtt;
+    if (reo_wnd < 1) reo_wnd = 1;
+
+    DCPSendRing *r = &dcp->snd_ring;
+    if (dupthresh) {
+        for (uint32_t sn = dcp->snd_una; sn != dcp->snd_nxt; sn++) {
+            uint32_t i = sn & r->mask;
+            if (r->sacked[i] || r->fastack[i] < dcp->fastresend) continue;
+            if (lost++ == 0) first_lost_sn = sn;
+            dcp_trace(dcp, DCP_TRACE_PKT_LOST, now, sn, r->xmit[i], 0, DCP_TRACE_REASON_FASTACK);
+            dcp_retransmit_seg(dcp, sn, now, DCP_TRACE_REASON_FASTACK);
+        }
+    } else if (dcp->rack_rtt >= 0) {
+        uint32_t sn = r->xhead;
+        for (uint32_t n = r->xlen; n > 0; n--) {
+            uint32_t i = sn & r->mask;
+            uint32_t next = r->xnext[i];
+            if (!dcp_rack_sent_before(dcp, sn, r->ts[i])) {
+                if (r->ts[i] != dcp->rack_xmit_ts) break;
+                sn = next;
+                continue;
+            }
+
+            uint32_t ts = r->ts[i];
+            if (dcp->fec_enc && r->xmit[i] == 1) {
+                uint32_t last = sn + dcp->fec_k - 1;
+                if (last - dcp->snd_una >= dcp->snd_nxt - dcp->snd_una) last = dcp->snd_nxt - 1;
+                if ((int32_t)(r->ts[last & r->mask] - ts) > 0) ts = r->ts[last & r->mask];
+            }
+
+            int32_t remaining = (int32_t)(ts + dcp->rack_rtt + reo_wnd - now);
+            if (remaining > 0) {
+                wait = remaining;
+                break;
+            }
+
+            if (lost++ == 0) first_lost_sn = sn;
+            dcp_trace(dcp, DCP_TRACE_PKT_LOST, now, sn, r->xmit[i], 0, DCP_TRACE_REASON_RACK);
+            dcp_retransmit_seg(dcp, sn, now, DCP_TRACE_REASON_RACK);
+            sn = next;
+        }
+    }
+    DCP_STAT_ADD(dcp->stats, losses_detected, lost);
+
+    if (lost > 0 && dcp->rack_reo_persist > 0 && --dcp->rack_reo_persist == 0) {
+        dcp->rack_reo_mult = 1;
+    }
+
+    dcp->rack_deadline = (wait >= 0) ? now + (uint32_t)wait : 0;
+
+    if (lost > 0 && dcp->cc_ops && dcp->cc_ops->on_loss) {
+        dcp->cc_ops->on_loss(dcp, first_lost_sn, now);
+    }
+}
+
+static void dcp_arm_loss_timer(DCPCB *dcp, uint32_t now) {
+    if (dcp->snd_una == dcp->snd_nxt) {
+        dcp->rack_deadline = 0;
+        dcp_scheduler_cancel(dcp->scheduler, &dcp->loss_timer);
+        return;
+    }
+
+    if (dcp->rack_deadline != 0) {
+        uint32_t delay = (int32_t)(dcp->rack_deadline - now) > 0 ? dcp->rack_deadline - now : 0;
+        dcp_scheduler_reschedule(dcp->scheduler, &dcp->loss_timer, delay);
+        return;
+    }
+
+    if (dcp->tlp_pending || dcp->rx_srtt <= 0) {
+        dcp_scheduler_cancel(dcp->scheduler, &dcp->loss_timer);
+        return;
+    }
+
+    uint32_t pto = 2 * (uint32_t)dcp->rx_srtt;
+    if (dcp->snd_buf_len == 1) {
+        pto += dcp->peer_ack_delay;
+    }
+    if (pto >= (uint32_t)dcp->rx_rto) {
+        dcp_scheduler_cancel(dcp->scheduler, &dcp->loss_timer);
+        return;
+    }
+    dcp_scheduler_reschedule(dcp->scheduler, &dcp->loss_timer, pto);
+}
+
+static void dcp_on_loss_timeout(DCPCB *dcp, uint32_t now) {
+    if (dcp->is_released) return;
+    if (dcp->snd_una == dcp->snd_nxt) return;
+
+    if (dcp->rack_deadline != 0) {
+        dcp_detect_loss(dcp, now);
+        dcp_arm_loss_timer(dcp, now);
+        return;
+    }
+
+    dcp->tlp_pending = 1;
+    DCP_STAT_INC(dcp->stats, tlp_probes);
+    dcp_trace(dcp, DCP_TRACE_TLP, now, dcp->snd_una, dcp->snd_nxt, 0, 0);
+
+    if (dcp->snd_queue_head.next == &dcp->snd_queue_head || !dcp_cwnd_open(dcp, 1) ||
+        dcp_send_new_seg(dcp, now) == NULL) {
+        uint32_t sn = dcp->snd_nxt;
+        while (sn != dcp->snd_una && dcp->snd_ring.sacked[(sn - 1) & dcp->snd_ring.mask]) {
+            sn--;
         }
+        if (sn == dcp->snd_una) return;
+        dcp_retransmit_seg(dcp, sn - 1, now, DCP_TRACE_REASON_TLP);
+    }
+
+    dcp_arm_rto_timer(dcp, now);
+}
+
+static void dcp_rcv_queue_push(DCPCB *dcp, DCPSEG *seg) {
+    list_add_tail_seg(&dcp->rcv_queue_head, seg);
+    dcp->rcv_queue_bytes += seg->len;
+
+    if (dcp->rcv_msg_first == NULL) {
+        dcp->rcv_msg_first = seg;
+    }
+    dcp->rcv_msg_bytes += seg->len;
+    seg->msg_len = 0;
+
+    if (seg->frg == 0) {
+        dcp->rcv_msg_first->msg_len = dcp->rcv_msg_bytes;
+        dcp->rcv_msg_first = NULL;
+        dcp->rcv_msg_bytes = 0;
     }
 }
 
-static void dcp_parse_data(DCPCB *dcp, DCPSEG *newseg) {
+static void dcp_parse_data(DCPCB *dcp, DCPSEG *newseg, uint32_t now) {
     uint32_t sn = newseg->sn;
     
-    if (sn >= dcp->rcv_nxt + dcp->rcv_wnd || sn < dcp->rcv_nxt) {
+    if (dcp->rcv_wnd > dcp->rcv_ring_mask + 1) {
+        dcp_rcv_ring_reserve(dcp, dcp->rcv_wnd);
+    }
+
+    if (sn - dcp->rcv_nxt >= dcp->rcv_wnd || sn - dcp->rcv_nxt > dcp->rcv_ring_mask) {
+        DCP_STAT_INC(dcp->stats, segs_out_of_window);
+        dcp_trace(dcp, DCP_TRACE_PKT_RECV, now, sn, newseg->len, dcp->rcv_nxt, DCP_TRACE_RECV_WINDOW);
         dcp_seg_free(dcp, newseg);
         return;
     }
-    
-    DCPSEG *p = dcp->rcv_buf_head.prev;
-    while (p != &dcp->rcv_buf_head) {
-        if (p->sn == sn) {
-            dcp_seg_free(dcp, newseg);
-            return;
-        }
-        if (p->sn < sn) {
-            break;
-        }
-        p = p->prev;
+    if (dcp_rcv_ring_test(dcp, sn)) {
+        DCP_STAT_INC(dcp->stats, segs_dup);
+        dcp_trace(dcp, DCP_TRACE_PKT_RECV, now, sn, newseg->len, dcp->rcv_nxt, DCP_TRACE_RECV_DUP);
+        dcp_seg_free(dcp, newseg);
+        return;
     }
+    DCP_STAT_INC(dcp->stats, segs_recv);
+    DCP_STAT_ADD(dcp->stats, bytes_recv, newseg->len);
+    dcp_trace(dcp, DCP_TRACE_PKT_RECV, now, sn, newseg->len, dcp->rcv_nxt, DCP_TRACE_RECV_OK);
     
-    list_add_before(p->next, newseg);
+    uint32_t slot = sn & dcp->rcv_ring_mask;
+    dcp->rcv_ring[slot] = newseg;
+    dcp->rcv_ring_bits[slot >> 6] |= 1ULL << (slot & 63);
     dcp->rcv_buf_len++;
 
-    while (dcp->rcv_buf_head.next != &dcp->rcv_buf_head) {
-        DCPSEG *seg = dcp->rcv_buf_head.next;
-        if (seg->sn == dcp->rcv_nxt) {
-            list_del_seg(seg);
-            list_add_tail_seg(&dcp->rcv_queue_head, seg);
-            dcp->rcv_buf_len--;
-            dcp->rcv_queue_len++;
-            dcp->rcv_nxt++;
-        } else {
-            break;
-        }
+    while (dcp->rcv_buf_len > 0 && dcp_rcv_ring_test(dcp, dcp->rcv_nxt)) {
+        slot = dcp->rcv_nxt & dcp->rcv_ring_mask;
+        dcp->rcv_ring_bits[slot >> 6] &= ~(1ULL << (slot & 63));
+        dcp_rcv_queue_push(dcp, dcp->rcv_ring[slot]);
+        dcp->rcv_buf_len--;
+        dcp->rcv_queue_len++;
+        dcp->rcv_nxt++;
     }
 }
 
 
 int dcp_input(DCPCB *dcp, const char *data, long size, uint32_t now) {
-    if (dcp == NULL || dcp->is_released || data == NULL || size < (long)DCP_OVERHEAD) {
+    if (dcp == NULL || dcp->is_released || data == NULL || size < (long)DCP_OVERHEAD_MIN) {
         return -1;
     }
     
     DCPSEG seg;
-    const char *ptr = data;
-    
-    ptr = dcp_decode_seg(ptr, &seg);
-    
-    if (seg.conv_id != dcp->conv_id) {
+    uint32_t conv_id;
+    _dcp_decode_32u(data, &conv_id);
+    if (conv_id != dcp->conv_id) {
         return -1;
     }
     
-    if (seg.len != (uint32_t)(size - DCP_OVERHEAD)) {
+    DCP_STAT_INC(dcp->stats, packets_in);
+    DCP_STAT_ADD(dcp->stats, bytes_in, size);
+
+    const char *ptr = dcp_decode_seg(dcp, data, size, &seg, now);
+    if (ptr == NULL) {
+        DCP_STAT_INC(dcp->stats, packets_invalid);
         return -1;
     }
     
     dcp->rmt_wnd = seg.wnd;
     
-    dcp_parse_una(dcp, seg.una);
+    dcp_rate_begin(dcp);
+    dcp_parse_una(dcp, seg.una, now);
     
     switch(seg.cmd) {
         case DCP_CMD_PUSH: {
-            if (seg.sn >= dcp->rcv_nxt + dcp->rcv_wnd || seg.sn < dcp->rcv_nxt) {
+            dcp->ack_ts_echo = seg.ts;
+            dcp->ack_latest_sn = seg.sn;
+            dcp->ack_count++;
+
+            if (dcp->rs.acked_bytes > 0) {
+                dcp_detect_loss(dcp, now);
+            }
+
+            if (!dcp_timer_pending(&dcp->ack_timer)) {
+                dcp_scheduler_add(dcp->scheduler, &dcp->ack_timer, dcp->ack_max_delay);
+                dcp->ack_delayed_until = now + dcp->ack_max_delay;
+            }
+
+            if (seg.sn - dcp->rcv_nxt >= dcp->rcv_wnd) {
+                if ((int32_t)(seg.sn - dcp->rcv_nxt) < 0) {
+                    DCP_STAT_INC(dcp->stats, segs_dup);
+                } else {
+                    DCP_STAT_INC(dcp->stats, segs_out_of_window);
+                }
+                dcp_trace(dcp, DCP_TRACE_PKT_RECV, now, seg.sn, seg.len, dcp->rcv_nxt,
+                          ((int32_t)(seg.sn - dcp->rcv_nxt) < 0) ? DCP_TRACE_RECV_DUP : DCP_TRACE_RECV_WINDOW);
+                dcp_ack_now(dcp, now);
                 break;
             }
             
@@ -467,45 +1962,187 @@ int dcp_input(DCPCB *dcp, const char *data, long size, uint32_t now) {
                 memcpy(newseg->data, ptr, seg.len);
             }
             
-            dcp_parse_data(dcp, newseg);
-            
-            if (dcp->ack_delayed_until == 0) {
-                dcp_scheduler_add(dcp->scheduler, dcp, 20, dcp_on_ack_delay_timeout);
-                dcp->ack_delayed_until = now + 20;
+            uint32_t expected_sn = dcp->rcv_nxt;
+            uint32_t held = dcp->rcv_buf_len;
+            dcp_parse_data(dcp, newseg, now);
+            if (dcp->fec_dec) {
+                dcp_fec_decoder_store(dcp->fec_dec, seg.sn, seg.frg, ptr, seg.len);
+                int group = dcp_fec_decoder_find(dcp->fec_dec, seg.sn);
+                if (group >= 0) {
+                    dcp_fec_recover_group(dcp, group, now);
+                }
+            }
+            if (seg.sn != expected_sn || held > 0 || dcp->rcv_buf_len > 0) {
+                dcp_ack_now(dcp, now);
+            } else if (dcp->ack_freq > 0 && dcp->ack_count >= dcp->ack_freq &&
+                       !dcp_data_due(dcp, dcp->ack_max_delay)) {
+                dcp_ack_now(dcp, now);
             }
             break;
         }
         case DCP_CMD_ACK: {
-            if (seg.ts == 0 || now < seg.ts) break;
-            
-            int32_t rtt = (int32_t)(now - seg.ts);
-            dcp_update_rtt(dcp, rtt);
-            
-            dcp_parse_fastack(dcp, seg.sn);
-            
-            if (dcp->cc_ops && dcp->cc_ops->on_ack) {
-                dcp->cc_ops->on_ack(dcp, rtt, 0, now);
+            DCP_STAT_INC(dcp->stats, acks_recv);
+            uint32_t maxsn = dcp_parse_sack(dcp, ptr, seg.len, seg.sn + 1, now) - 1;
+
+            uint32_t age = now - seg.ts;
+            if (dcp->hdr_compact_peer) age &= DCP_HDR_TS_MASK;
+            if (seg.ts != 0 && (int32_t)age >= 0) {
+                dcp->rs.rtt_ms = (int32_t)age;
             }
             
-            if (dcp->pacing_timer_armed == 0 && dcp->snd_queue_len > 0) {
-                dcp_scheduler_add(dcp->scheduler, dcp, 0, dcp_flush_data);
-                dcp->pacing_timer_armed = 1;
-            }
+            dcp_parse_fastack(dcp, maxsn);
+            dcp_detect_loss(dcp, now);
             break;
         }
         case DCP_CMD_PROBE: {
             break;
         }
+        case DCP_CMD_ACKFREQ: {
+            dcp_parse_ackfreq(dcp, ptr, seg.len, now);
+            break;
+        }
+        case DCP_CMD_FEC: {
+            if (dcp->fec_dec == NULL || seg.len <= DCP_FEC_HDR) break;
+            DCP_STAT_INC(dcp->stats, fec_parity_recv);
+
+            uint32_t k = (unsigned char)ptr[0];
+            dcp_fec_decoder_expire(dcp->fec_dec, dcp->rcv_nxt);
+            if ((int32_t)(seg.sn + k - dcp->rcv_nxt) <= 0) break;
+
+            int group = dcp_fec_decoder_parity(dcp->fec_dec, seg.sn, k, (unsigned char)ptr[2],
+                                               ptr + DCP_FEC_HDR, seg.len - DCP_FEC_HDR);
+            if (group >= 0 && dcp_fec_recover_group(dcp, group, now) > 0) {
+                dcp_ack_now(dcp, now);
+            }
+            break;
+        }
         default:
             break;
     }
 
+    if (dcp->rs.rtt_ms >= 0) {
+        dcp_update_rtt(dcp, dcp->rs.rtt_ms);
+    }
+
+    if (dcp->ack_freq_req_pending && now - dcp->ack_freq_req_ts >= (uint32_t)dcp->rx_rto) {
+        dcp_send_ackfreq(dcp, dcp->ack_freq_req_seq, 0, now);
+    }
+
+    if (dcp->rs.acked_bytes > 0) {
+        dcp->rto_restart_ts = now + dcp->rx_rto;
+    }
+    if (dcp->rs.acked_bytes > 0 || seg.cmd == DCP_CMD_ACK) {
+        dcp_arm_rto_timer(dcp, now);
+    }
+
+    if (dcp->rs.acked_bytes > 0) {
+        dcp->tlp_pending = 0;
+    }
+    if (dcp->rs.acked_bytes > 0 || seg.cmd == DCP_CMD_ACK) {
+        dcp_arm_loss_timer(dcp, now);
+    }
+
+    if (dcp->rs.acked_bytes > 0 || dcp->rs.rtt_ms >= 0) {
+        dcp_rate_gen(dcp);
+        
+        if (dcp->cc_ops && dcp->cc_ops->on_ack) {
+            dcp->cc_ops->on_ack(dcp, dcp->rs.rtt_ms, dcp->rs.acked_bytes, now);
+        }
+        if (dcp->trace) {
+            dcp_trace(dcp, DCP_TRACE_METRICS, now, dcp->cc_ops->get_cwnd(dcp), (uint32_t)dcp->rx_srtt,
+                      dcp->cc_ops->get_pacing_rate(dcp), 0);
+        }
+        
+        if (!dcp_timer_pending(&dcp->pacing_timer) && dcp->snd_queue_len > 0) {
+            dcp_scheduler_add(dcp->scheduler, &dcp->pacing_timer, 0);
+        }
+    }
+
     return 0;
 }
 
-int dcp_send(DCPCB *dcp, const char *buffer, int len, uint32_t now) {
-    if (dcp == NULL || dcp->is_released || len <= 0) return -1;
+static void dcp_copy_iov(char *dst, int size, const struct iovec *iov, int *vi, size_t *voff) {
+    int filled = 0;
+    while (filled < size) {
+        size_t avail = iov[*vi].iov_len - *voff;
+        size_t chunk = (avail < (size_t)(size - filled)) ? avail : (size_t)(size - filled);
+        memcpy(dst + filled, (const char*)iov[*vi].iov_base + *voff, chunk);
+        filled += (int)chunk;
+        *voff += chunk;
+        if (*voff == iov[*vi].iov_len) {
+            (*vi)++;
+            *voff = 0;
+        }
+    }
+}
+
+static int dcp_stream_append(DCPCB *dcp, const struct iovec *iov, int len) {
+    DCPSEG *tail = dcp->stream_tail;
+    int space = (tail != NULL) ? (int)(dcp->mss - tail->len) : 0;
+    int count = (len > space) ? (len - space + (int)dcp->mss - 1) / (int)dcp->mss : 0;
+
+    if (dcp->snd_queue_len + dcp->snd_buf_len + count > dcp->snd_wnd * 2) {
+        return -2;
+    }
+
+    DCPSEG pending;
+    list_init_seg_head(&pending);
+    for (int i = 0; i < count; i++) {
+        DCPSEG *seg = dcp_seg_create(dcp, dcp->mss);
+        if (seg == NULL) {
+            dcp_flush_queue(dcp, &pending);
+            return -3;
+        }
+        seg->len = 0;
+        seg->frg = 0;
+        list_add_tail_seg(&pending, seg);
+    }
+
+    int vi = 0;
+    size_t voff = 0;
+    if (space > 0) {
+        int size = (len < space) ? len : space;
+        dcp_copy_iov(tail->data + tail->len, size, iov, &vi, &voff);
+        tail->len += size;
+        len -= size;
+    }
+
+    while (pending.next != &pending) {
+        DCPSEG *seg = pending.next;
+        int size = (len > (int)dcp->mss) ? (int)dcp->mss : len;
+        dcp_copy_iov(seg->data, size, iov, &vi, &voff);
+        seg->len = size;
+        len -= size;
+
+        list_del_seg(seg);
+        list_add_tail_seg(&dcp->snd_queue_head, seg);
+        dcp->snd_queue_len++;
+        dcp->stream_tail = seg;
+        dcp->stream_deadline_us = dcp_scheduler_now_us(dcp->scheduler) +
+                                  (uint64_t)dcp->stream_cork_ms * 1000;
+    }
+
+    if (!dcp_timer_pending(&dcp->pacing_timer)) {
+        dcp_scheduler_add(dcp->scheduler, &dcp->pacing_timer, 0);
+    }
+    return 0;
+}
+
+int dcp_sendv(DCPCB *dcp, const struct iovec *iov, int iovcnt, uint32_t now) {
+    (void)now;
+    if (dcp == NULL || dcp->is_released || iov == NULL || iovcnt <= 0) return -1;
 
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    if (total == 0 || total > 0x7fffffff) return -1;
+
+    if (dcp->stream) {
+        return dcp_stream_append(dcp, iov, (int)total);
+    }
+
+    int len = (int)total;
     int count = 0;
     if (len <= (int)dcp->mss) {
         count = 1;
@@ -517,46 +2154,101 @@ int dcp_send(DCPCB *dcp, const char *buffer, int len, uint32_t now) {
         return -2;
     }
 
-    int offset = 0;
+    DCPSEG pending;
+    list_init_seg_head(&pending);
+
+    int vi = 0;
+    size_t voff = 0;
     for (int i = 0; i < count; i++) {
         int size = (len > (int)dcp->mss) ? (int)dcp->mss : len;
         DCPSEG *seg = dcp_seg_create(dcp, size);
-        if (seg == NULL) return -3;
+        if (seg == NULL) {
+            dcp_flush_queue(dcp, &pending);
+            return -3;
+        }
         
-        memcpy(seg->data, buffer + offset, size);
-        offset += size;
+        dcp_copy_iov(seg->data, size, iov, &vi, &voff);
         len -= size;
         
         seg->frg = (count - 1) - i;
         
+        list_add_tail_seg(&pending, seg);
+    }
+
+    while (pending.next != &pending) {
+        DCPSEG *seg = pending.next;
+        list_del_seg(seg);
         list_add_tail_seg(&dcp->snd_queue_head, seg);
         dcp->snd_queue_len++;
     }
     
-    if (dcp->pacing_timer_armed == 0) {
-        dcp_scheduler_add(dcp->scheduler, dcp, 0, dcp_flush_data);
-        dcp->pacing_timer_armed = 1;
+    if (!dcp_timer_pending(&dcp->pacing_timer)) {
+        dcp_scheduler_add(dcp->scheduler, &dcp->pacing_timer, 0);
     }
 
     return 0;
 }
 
+int dcp_send(DCPCB *dcp, const char *buffer, int len, uint32_t now) {
+    if (buffer == NULL || len <= 0) return -1;
+
+    struct iovec iov;
+    iov.iov_base = (void*)buffer;
+    iov.iov_len = (size_t)len;
+    return dcp_sendv(dcp, &iov, 1, now);
+}
+
+int dcp_peeksize(const DCPCB *dcp) {
+    if (dcp == NULL || dcp->is_released) return -1;
+
+    if (dcp->stream) {
+        return (dcp->rcv_queue_bytes > 0) ? (int)(dcp->rcv_queue_bytes - dcp->rcv_stream_off) : -1;
+    }
+
+    const DCPSEG *seg = dcp->rcv_queue_head.next;
+    if (seg == &dcp->rcv_queue_head || seg->msg_len == 0) {
+        return -1;
+    }
+    return (int)seg->msg_len;
+}
+
+static int dcp_recv_stream(DCPCB *dcp, char *buffer, int len) {
+    int recovered_len = 0;
+    while (recovered_len < len && dcp->rcv_queue_head.next != &dcp->rcv_queue_head) {
+        DCPSEG *seg = dcp->rcv_queue_head.next;
+        int avail = (int)(seg->len - dcp->rcv_stream_off);
+        int size = (avail < len - recovered_len) ? avail : len - recovered_len;
+
+        if (buffer) {
+            memcpy(buffer + recovered_len, seg->data + dcp->rcv_stream_off, size);
+        }
+        recovered_len += size;
+        dcp->rcv_stream_off += size;
+
+        if (dcp->rcv_stream_off == seg->len) {
+            list_del_seg(seg);
+            dcp->rcv_queue_bytes -= seg->len;
+            dcp->rcv_stream_off = 0;
+            dcp_seg_free(dcp, seg);
+            dcp->rcv_queue_len--;
+        }
+    }
+    return recovered_len;
+}
+
 int dcp_recv(DCPCB *dcp, char *buffer, int len) {
     if (dcp == NULL || dcp->is_released) return -1;
 
-    if (dcp->rcv_queue_head.next == &dcp->rcv_queue_head) {
-        return 0;
+    if (dcp->stream) {
+        return (len > 0) ? dcp_recv_stream(dcp, buffer, len) : -2;
     }
 
-    int peeksize = 0;
-    DCPSEG *node = dcp->rcv_queue_head.next;
-    while(node != &dcp->rcv_queue_head) {
-        peeksize += node->len;
-        if (node->frg == 0) break;
-        node = node->next;
+    int peeksize = dcp_peeksize(dcp);
+    if (peeksize < 0) {
+        return 0;
     }
     
-    if (peeksize <= 0 || peeksize > len) {
+    if (peeksize > len) {
         return -2;
     }
 
@@ -569,6 +2261,7 @@ int dcp_recv(DCPCB *dcp, char *buffer, int len) {
             memcpy(buffer + recovered_len, seg->data, seg->len);
         }
         recovered_len += seg->len;
+        dcp->rcv_queue_bytes -= seg->len;
         
         uint32_t frg = seg->frg;
         dcp_seg_free(dcp, seg);
@@ -581,3 +2274,45 @@ int dcp_recv(DCPCB *dcp, char *buffer, int len) {
     
     return recovered_len;
 }
+
+int dcp_recv_zc(DCPCB *dcp, struct iovec *iov, int iovcnt) {
+    if (dcp == NULL || dcp->is_released || iov == NULL) return -1;
+
+    DCPSEG *first = dcp->rcv_queue_head.next;
+    if (first == &dcp->rcv_queue_head) {
+        return 0;
+    }
+
+    int count;
+    if (dcp->stream) {
+        count = (dcp->rcv_queue_len < (uint32_t)iovcnt) ? (int)dcp->rcv_queue_len : iovcnt;
+    } else {
+        if (first->msg_len == 0) return 0;
+        count = (int)first->frg + 1;
+        if (count > iovcnt) {
+            return -2;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        DCPSEG *seg = dcp->rcv_queue_head.next;
+        list_del_seg(seg);
+        list_add_tail_seg(&dcp->rcv_held_head, seg);
+        dcp->rcv_queue_len--;
+        dcp->rcv_queue_bytes -= seg->len;
+        dcp->rcv_held_len++;
+
+        iov[i].iov_base = seg->data + dcp->rcv_stream_off;
+        iov[i].iov_len = seg->len - dcp->rcv_stream_off;
+        dcp->rcv_stream_off = 0;
+    }
+
+    return count;
+}
+
+void dcp_recv_release(DCPCB *dcp) {
+    if (dcp == NULL) return;
+
+    dcp_flush_queue(dcp, &dcp->rcv_held_head);
+    dcp->rcv_held_len = 0;
+}
@@ -3,20 +3,69 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 #include "dcp_scheduler.h"
 
 #define DCP_CMD_PUSH     81
 #define DCP_CMD_ACK      82
 #define DCP_CMD_PROBE    85
+#define DCP_CMD_ACKFREQ  86
+#define DCP_CMD_FEC      87
 
-#define DCP_OVERHEAD     24
+#define DCP_OVERHEAD     32
+#define DCP_OVERHEAD_MIN 14
 #define DCP_MTU_DEF      1400
+#define DCP_BATCH_MAX    64
+
+#define DCP_ACK_DELAY_MS     20
+#define DCP_ACK_FREQ_DEF     2
+#define DCP_ACKFREQ_SIZE     12
+#define DCP_RTO_MAX          60000
+#define DCP_RACK_REO_MULT_MAX 8
+#define DCP_RACK_REO_PERSIST  16
+
+#define DCP_RCV_RING_MIN     64
+#define DCP_RCV_RING_MAX     (1u << 20)
+#define DCP_SND_RING_MIN     64
+#define DCP_SND_RING_MAX     (1u << 20)
+
+#define DCP_HDR_CAP_COMPACT  0x100
+#define DCP_HDR_COMPACT      0x80
+#define DCP_HDR_WIDE         0x40
+#define DCP_HDR_FRG          0x20
+#define DCP_HDR_CMD_MASK     0x0F
+#define DCP_HDR_TS_MASK      0xFFFFFFu
+#define DCP_HDR_NARROW_SPAN  16384
+
+#define DCP_SACK_MAX_BLOCKS  8
+#define DCP_SACK_BLOCK_SIZE  8
 
 struct DCPCB;
+struct DCPEndpoint;
+
+#define DCP_ADDR_MAX     28
+
+typedef struct DCPAddr {
+    uint32_t len;
+    char data[DCP_ADDR_MAX];
+} DCPAddr;
+
+typedef struct DCPPacket {
+    const char *data;
+    int len;
+} DCPPacket;
 
 typedef int (*dcp_output_callback)(const char *buffer, int len, 
                                    struct DCPCB *dcp, void *user);
 
+typedef int (*dcp_outputv_callback)(const struct iovec *iov, int iovcnt, 
+                                    struct DCPCB *dcp, void *user);
+
+typedef int (*dcp_output_batch_callback)(const DCPPacket *packets, int count, 
+                                         struct DCPCB *dcp, void *user);
+
+typedef void (*dcp_release_callback)(struct DCPCB *dcp);
+
 struct dcp_cc_ops {
     void (*init)(struct DCPCB *dcp);
     void (*release)(struct DCPCB *dcp);
@@ -27,12 +76,97 @@ struct dcp_cc_ops {
     uint64_t (*get_pacing_rate)(struct DCPCB *dcp);
 };
 
+#define DCP_BBR_STARTUP    0
+#define DCP_BBR_DRAIN      1
+#define DCP_BBR_PROBE_BW   2
+#define DCP_BBR_PROBE_RTT  3
+
+typedef struct {
+    uint64_t prior_delivered;
+    uint32_t prior_ts;
+    uint32_t delivered;
+    uint32_t acked_bytes;
+    int32_t interval_ms;
+    int32_t rtt_ms;
+    uint64_t delivery_rate;
+    int is_app_limited;
+} DCPRateSample;
+
+typedef struct {
+    uint32_t t;
+    uint64_t v;
+} DCPMinMaxSample;
+
 typedef struct {
     int state; 
     uint64_t btl_bw;
     uint32_t rt_prop;
+    uint32_t rt_prop_stamp;
+    DCPMinMaxSample bw_filter[3];
+
+    uint32_t round_count;
+    uint64_t next_round_delivered;
+    int round_start;
+
+    uint64_t full_bw;
+    uint32_t full_bw_cnt;
+    int full_bw_reached;
+
+    uint32_t pacing_gain;
+    uint32_t cwnd_gain;
+    uint32_t cycle_idx;
+    uint32_t cycle_stamp;
+    uint32_t loss_rounds;
+    uint64_t round_lost;
+    uint64_t round_delivered;
+
+    uint32_t probe_rtt_done_stamp;
+    int probe_rtt_round_done;
+    int idle_restart;
+
+    uint32_t cwnd;
+    uint32_t prior_cwnd;
+    int packet_conservation;
+    uint32_t conservation_round;
 } DCPBBRState;
 
+typedef struct DCPStats {
+    int32_t srtt;
+    int32_t rttvar;
+    int32_t rto;
+    int32_t min_rtt;
+    uint32_t cwnd;
+    uint32_t inflight_bytes;
+    uint64_t pacing_rate;
+    uint32_t snd_queue_len;
+    uint32_t snd_buf_len;
+    uint32_t rcv_queue_len;
+    uint32_t rcv_buf_len;
+
+    uint64_t packets_in;
+    uint64_t packets_invalid;
+    uint64_t bytes_in;
+    uint64_t segs_sent;
+    uint64_t bytes_sent;
+    uint64_t segs_retrans;
+    uint64_t bytes_retrans;
+    uint64_t segs_recv;
+    uint64_t bytes_recv;
+    uint64_t segs_dup;
+    uint64_t segs_out_of_window;
+    uint64_t acks_sent;
+    uint64_t acks_recv;
+    uint64_t losses_detected;
+    uint64_t spurious_retrans;
+    uint64_t rto_timeouts;
+    uint64_t tlp_probes;
+    uint64_t pacing_limited;
+    uint64_t cwnd_limited;
+    uint64_t fec_parity_sent;
+    uint64_t fec_parity_recv;
+    uint64_t fec_recovered;
+} DCPStats;
+
 typedef struct DCPSEG {
     struct DCPSEG *prev, *next;
     uint32_t conv_id;
@@ -43,17 +177,41 @@ typedef struct DCPSEG {
     uint32_t sn;
     uint32_t una;
     uint32_t len;
-    uint32_t resendts;
-    uint32_t rto;
-    uint32_t fastack;
-    uint32_t xmit;
+    uint32_t msg_len;
+    uint64_t delivered;
+    uint32_t delivered_ts;
+    uint32_t first_sent_ts;
+    int is_app_limited;
     char data[1];
 } DCPSEG;
 
+typedef struct DCPSendRing {
+    uint32_t mask;
+    DCPSEG **seg;
+    uint32_t *ts;
+    uint32_t *resendts;
+    uint32_t *rto;
+    uint32_t *xmit;
+    uint32_t *fastack;
+    uint32_t *xnext;
+    uint32_t *xprev;
+    uint8_t *sacked;
+    uint32_t xhead;
+    uint32_t xtail;
+    uint32_t xlen;
+    uint32_t rto_floor;
+} DCPSendRing;
+
 typedef struct DCPCB {
     void *user;
     uint32_t conv_id;
     uint32_t token;
+    struct DCPEndpoint *endpoint;
+    uint64_t endpoint_handle;
+    dcp_release_callback on_release;
+    void *transport;
+    void *send_backlog;
+    DCPAddr peer_addr;
     uint32_t state;
     uint32_t mtu;
     uint32_t mss;
@@ -79,25 +237,93 @@ typedef struct DCPCB {
     uint64_t pace_rate_bytes_per_sec;
     uint64_t next_send_time_us;
 
+    uint64_t delivered;
+    uint64_t lost;
+    uint32_t delivered_ts;
+    uint32_t first_sent_ts;
+    uint64_t app_limited;
+    uint32_t inflight_bytes;
+    DCPRateSample rs;
+
     dcp_output_callback output;
+    dcp_outputv_callback outputv;
+    dcp_output_batch_callback output_batch;
+
+    uint32_t pacing_burst;
+    DCPPacket *batch;
+    int batch_count;
 
     struct DCPSEG snd_queue_head;
     struct DCPSEG rcv_queue_head;
-    struct DCPSEG snd_buf_head;
-    struct DCPSEG rcv_buf_head;
+    struct DCPSEG rcv_held_head;
+
+    DCPSendRing snd_ring;
+
+    DCPSEG **rcv_ring;
+    uint64_t *rcv_ring_bits;
+    uint32_t rcv_ring_mask;
     
     uint32_t snd_queue_len;
     uint32_t rcv_queue_len;
+    uint32_t rcv_held_len;
     uint32_t snd_buf_len;
     uint32_t rcv_buf_len;
 
+    DCPSEG *rcv_msg_first;
+    uint32_t rcv_msg_bytes;
+    uint32_t rcv_queue_bytes;
+
+    int stream;
+    uint32_t stream_cork_ms;
+    DCPSEG *stream_tail;
+    uint64_t stream_deadline_us;
+    uint32_t rcv_stream_off;
+
+    uint32_t fec_k;
+    uint32_t fec_m;
+    struct DCPFecEncoder *fec_enc;
+    struct DCPFecDecoder *fec_dec;
+
     uint32_t ack_delayed_until;
     uint32_t ack_count;
-    uint32_t ack_list[128];
+    uint32_t ack_ts_echo;
+    uint32_t ack_latest_sn;
+    uint32_t ack_freq;
+    uint32_t ack_max_delay;
+    uint32_t ack_freq_seq;
+
+    uint32_t peer_ack_delay;
+    uint32_t ack_freq_req_seq;
+    uint32_t ack_freq_req_pkts;
+    uint32_t ack_freq_req_delay;
+    uint32_t ack_freq_req_ts;
+    int ack_freq_req_pending;
     
     uint32_t fastresend;
     int32_t nocwnd;
 
+    int hdr_compact;
+    int hdr_compact_peer;
+
+    uint32_t rack_xmit_ts;
+    uint32_t rack_sn;
+    int32_t rack_rtt;
+    int32_t rack_min_rtt;
+    uint32_t rack_deadline;
+    uint32_t rack_reo_mult;
+    uint32_t rack_reo_persist;
+    uint32_t rack_reo_ts;
+    uint32_t rto_restart_ts;
+    int tlp_pending;
+
+    DCPTimerNode rto_timer;
+    DCPTimerNode pacing_timer;
+    DCPTimerNode ack_timer;
+    DCPTimerNode loss_timer;
+
+    DCPStats stats;
+    int trace;
+
 } DCPCB;
 
 DCPCB* dcp_create(uint32_t conv_id, uint32_t token, void *user, 
@@ -107,14 +333,46 @@ void dcp_release(DCPCB *dcp);
 
 void dcp_set_output(DCPCB *dcp, dcp_output_callback output);
 
+void dcp_set_outputv(DCPCB *dcp, dcp_outputv_callback outputv);
+
+void dcp_set_output_batch(DCPCB *dcp, dcp_output_batch_callback output_batch);
+
+int dcp_set_pacing_burst(DCPCB *dcp, int max_burst);
+
 int dcp_input(DCPCB *dcp, const char *data, long size, uint32_t now);
 
 int dcp_send(DCPCB *dcp, const char *buffer, int len, uint32_t now);
 
+int dcp_sendv(DCPCB *dcp, const struct iovec *iov, int iovcnt, uint32_t now);
+
 int dcp_recv(DCPCB *dcp, char *buffer, int len);
 
+int dcp_peeksize(const DCPCB *dcp);
+
+int dcp_recv_zc(DCPCB *dcp, struct iovec *iov, int iovcnt);
+
+void dcp_recv_release(DCPCB *dcp);
+
 int dcp_set_congestion_control(DCPCB *dcp, const char *algo_name);
 
 int dcp_setmtu(DCPCB *dcp, int mtu);
 
+int dcp_wndsize(DCPCB *dcp, int sndwnd, int rcvwnd);
+
+int dcp_set_compact_header(DCPCB *dcp, int enable);
+
+int dcp_set_ack_frequency(DCPCB *dcp, int pkts, int max_delay_ms);
+
+int dcp_request_ack_frequency(DCPCB *dcp, int pkts, int max_delay_ms, uint32_t now);
+
+int dcp_get_stats(DCPCB *dcp, DCPStats *stats);
+
+int dcp_set_trace(DCPCB *dcp, int enable);
+
+int dcp_set_stream(DCPCB *dcp, int enable, int cork_ms);
+
+int dcp_stream_flush(DCPCB *dcp);
+
+int dcp_set_fec(DCPCB *dcp, int k, int m);
+
 #endif
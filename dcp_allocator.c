@@ -1,5 +1,6 @@
 #include "dcp_allocator.h"
 #include <stdlib.h>
+#include <string.h>
 
 static void* dcp_default_malloc(size_t size) {
     return malloc(size);
@@ -24,3 +25,131 @@ dcp_malloc_fn dcp_get_malloc(void) {
 dcp_free_fn dcp_get_free(void) {
     return g_free_fn;
 }
+
+static const uint32_t g_pool_class_size[DCP_POOL_CLASSES] = { 128, 512, 1664, 9216 };
+
+DCPPool* dcp_pool_create(void) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    DCPPool *pool = (DCPPool*)malloc_fn(sizeof(DCPPool));
+    if (pool == NULL) return NULL;
+
+    memset(pool, 0, sizeof(DCPPool));
+    pool->alloc_fn = malloc_fn;
+    pool->free_fn = dcp_get_free();
+
+    for (int i = 0; i < DCP_POOL_CLASSES; i++) {
+        pool->stats.class_size[i] = g_pool_class_size[i];
+    }
+
+    return pool;
+}
+
+void dcp_pool_release(DCPPool *pool) {
+    if (pool == NULL) return;
+
+    DCPPoolSlab *slab = pool->slabs;
+    while (slab) {
+        DCPPoolSlab *to_free = slab;
+        slab = slab->next;
+        pool->free_fn(to_free);
+    }
+
+    pool->free_fn(pool);
+}
+
+static size_t dcp_pool_stride(uint32_t class_idx) {
+    return sizeof(DCPPoolBlock) + g_pool_class_size[class_idx];
+}
+
+static int dcp_pool_grow(DCPPool *pool, uint32_t class_idx) {
+    size_t stride = dcp_pool_stride(class_idx);
+    uint32_t count = (uint32_t)(DCP_POOL_SLAB_BYTES / stride);
+    if (count < 4) count = 4;
+
+    size_t bytes = sizeof(DCPPoolSlab) + stride * count;
+    DCPPoolSlab *slab = (DCPPoolSlab*)pool->alloc_fn(bytes);
+    if (slab == NULL) return -1;
+
+    slab->class_idx = class_idx;
+    slab->block_count = count;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+
+    char *base = (char*)(slab + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        DCPPoolBlock *block = (DCPPoolBlock*)(base + stride * i);
+        block->class_idx = class_idx;
+        block->next_free = pool->free_list[class_idx];
+        pool->free_list[class_idx] = block;
+    }
+
+    pool->stats.slab_allocs++;
+    pool->stats.reserved_bytes += bytes;
+    pool->stats.free_blocks += count;
+    pool->stats.class_free[class_idx] += count;
+    return 0;
+}
+
+void* dcp_pool_alloc(DCPPool *pool, size_t size) {
+    if (pool == NULL) {
+        return dcp_get_malloc()(size);
+    }
+
+    uint32_t class_idx = 0;
+    while (class_idx < DCP_POOL_CLASSES && size > g_pool_class_size[class_idx]) {
+        class_idx++;
+    }
+
+    DCPPoolBlock *block;
+    if (class_idx == DCP_POOL_CLASSES) {
+        block = (DCPPoolBlock*)pool->alloc_fn(sizeof(DCPPoolBlock) + size);
+        if (block == NULL) return NULL;
+        block->class_idx = DCP_POOL_LARGE;
+        pool->stats.large_allocs++;
+    } else {
+        if (pool->free_list[class_idx] == NULL && dcp_pool_grow(pool, class_idx) != 0) {
+            return NULL;
+        }
+        block = pool->free_list[class_idx];
+        pool->free_list[class_idx] = block->next_free;
+        pool->stats.free_blocks--;
+        pool->stats.class_free[class_idx]--;
+        pool->stats.class_in_use[class_idx]++;
+    }
+
+    block->pool = pool;
+    pool->stats.allocs++;
+    pool->stats.in_use++;
+    return block + 1;
+}
+
+void dcp_pool_free(DCPPool *pool, void *ptr) {
+    if (ptr == NULL) return;
+    if (pool == NULL) {
+        dcp_get_free()(ptr);
+        return;
+    }
+
+    DCPPoolBlock *block = (DCPPoolBlock*)ptr - 1;
+    uint32_t class_idx = block->class_idx;
+
+    pool->stats.frees++;
+    pool->stats.in_use--;
+
+    if (class_idx == DCP_POOL_LARGE) {
+        pool->free_fn(block);
+        return;
+    }
+
+    block->next_free = pool->free_list[class_idx];
+    pool->free_list[class_idx] = block;
+    pool->stats.free_blocks++;
+    pool->stats.class_free[class_idx]++;
+    pool->stats.class_in_use[class_idx]--;
+}
+
+void dcp_pool_get_stats(const DCPPool *pool, DCPPoolStats *stats) {
+    if (pool == NULL || stats == NULL) return;
+    *stats = pool->stats;
+}
@@ -1,26 +1,68 @@
-#include "dcp_allocator.h"
-#include <stdlib.h>
+#ifndef __DCP_ALLOCATOR_H__
+#define __DCP_ALLOCATOR_H__
 
-static void* dcp_default_malloc(size_t size) {
-    return malloc(size);
-}
-static void dcp_default_free(void *ptr) {
-    free(ptr);
-}
+#include <stddef.h>
+#include <stdint.h>
 
-static dcp_malloc_fn g_malloc_fn = dcp_default_malloc;
-static dcp_free_fn g_free_fn = dcp_default_free;
+typedef void* (*dcp_malloc_fn)(size_t size);
+typedef void (*dcp_free_fn)(void *ptr);
 
+void dcp_set_allocator(dcp_malloc_fn malloc_fn, dcp_free_fn free_fn);
 
-void dcp_set_allocator(dcp_malloc_fn malloc_fn, dcp_free_fn free_fn) {
-    g_malloc_fn = malloc_fn ? malloc_fn : dcp_default_malloc;
-    g_free_fn = free_fn ? free_fn : dcp_default_free;
-}
+dcp_malloc_fn dcp_get_malloc(void);
 
-dcp_malloc_fn dcp_get_malloc(void) {
-    return g_malloc_fn;
-}
+dcp_free_fn dcp_get_free(void);
 
-dcp_free_fn dcp_get_free(void) {
-    return g_free_fn;
-}
+#define DCP_POOL_CLASSES      4
+#define DCP_POOL_SLAB_BYTES   (64 * 1024)
+#define DCP_POOL_LARGE        0xFFFFFFFFu
+
+typedef struct DCPPoolBlock {
+    union {
+        struct DCPPoolBlock *next_free;
+        struct DCPPool *pool;
+    };
+    uint32_t class_idx;
+    uint32_t reserved;
+} DCPPoolBlock;
+
+typedef struct DCPPoolSlab {
+    struct DCPPoolSlab *next;
+    uint32_t class_idx;
+    uint32_t block_count;
+} DCPPoolSlab;
+
+typedef struct DCPPoolStats {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t large_allocs;
+    uint64_t slab_allocs;
+    uint32_t in_use;
+    uint32_t free_blocks;
+    size_t reserved_bytes;
+    uint32_t class_size[DCP_POOL_CLASSES];
+    uint32_t class_in_use[DCP_POOL_CLASSES];
+    uint32_t class_free[DCP_POOL_CLASSES];
+} DCPPoolStats;
+
+typedef struct DCPPool {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    DCPPoolBlock *free_list[DCP_POOL_CLASSES];
+    DCPPoolSlab *slabs;
+
+    DCPPoolStats stats;
+} DCPPool;
+
+DCPPool* dcp_pool_create(void);
+
+void dcp_pool_release(DCPPool *pool);
+
+void* dcp_pool_alloc(DCPPool *pool, size_t size);
+
+void dcp_pool_free(DCPPool *pool, void *ptr);
+
+void dcp_pool_get_stats(const DCPPool *pool, DCPPoolStats *stats);
+
+#endif
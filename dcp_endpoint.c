@@ -0,0 +1,253 @@
+#include "dcp_endpoint.h"
+#include <string.h>
+
+static inline DCPHandle dcp_make_handle(uint32_t generation, uint32_t index) {
+    return ((uint64_t)generation << 32) | index;
+}
+
+static int dcp_endpoint_rehash(DCPEndpoint *ep, uint32_t cap) {
+    DCPEndpointEntry *table = (DCPEndpointEntry*)ep->alloc_fn(cap * sizeof(DCPEndpointEntry));
+    if (table == NULL) return -1;
+    memset(table, 0, cap * sizeof(DCPEndpointEntry));
+
+    uint32_t mask = cap - 1;
+    if (ep->table != NULL) {
+        for (uint32_t i = 0; i <= ep->table_mask; i++) {
+            DCPEndpointEntry *e = &ep->table[i];
+            if (e->slot == 0) continue;
+            uint32_t pos = dcp_conv_hash(e->conv_id) & mask;
+            while (table[pos].slot != 0) {
+                pos = (pos + 1) & mask;
+            }
+            table[pos] = *e;
+        }
+        ep->free_fn(ep->table);
+    }
+
+    ep->table = table;
+    ep->table_mask = mask;
+    return 0;
+}
+
+static int dcp_endpoint_grow_slots(DCPEndpoint *ep) {
+    uint32_t cap = ep->slot_cap ? ep->slot_cap * 2 : DCP_ENDPOINT_INIT_CAP;
+    DCPEndpointSlot *slots = (DCPEndpointSlot*)ep->alloc_fn(cap * sizeof(DCPEndpointSlot));
+    if (slots == NULL) return -1;
+
+    if (ep->slots != NULL) {
+        memcpy(slots, ep->slots, ep->slot_cap * sizeof(DCPEndpointSlot));
+        ep->free_fn(ep->slots);
+    }
+    memset(slots + ep->slot_cap, 0, (cap - ep->slot_cap) * sizeof(DCPEndpointSlot));
+
+    ep->slots = slots;
+    ep->slot_cap = cap;
+    return 0;
+}
+
+static DCPEndpointEntry* dcp_endpoint_lookup(const DCPEndpoint *ep, uint32_t conv_id) {
+    uint32_t pos = dcp_conv_hash(conv_id) & ep->table_mask;
+    while (ep->table[pos].slot != 0) {
+        if (ep->table[pos].conv_id == conv_id) {
+            return &ep->table[pos];
+        }
+        pos = (pos + 1) & ep->table_mask;
+    }
+    return NULL;
+}
+
+static void dcp_endpoint_erase(DCPEndpoint *ep, DCPEndpointEntry *entry) {
+    uint32_t mask = ep->table_mask;
+    uint32_t hole = (uint32_t)(entry - ep->table);
+    uint32_t pos = hole;
+
+    for (;;) {
+        pos = (pos + 1) & mask;
+        if (ep->table[pos].slot == 0) break;
+
+        uint32_t home = dcp_conv_hash(ep->table[pos].conv_id) & mask;
+        if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+            ep->table[hole] = ep->table[pos];
+            hole = pos;
+        }
+    }
+    ep->table[hole].slot = 0;
+    ep->table[hole].conv_id = 0;
+}
+
+DCPEndpoint* dcp_endpoint_create(void *user) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    DCPEndpoint *ep = (DCPEndpoint*)malloc_fn(sizeof(DCPEndpoint));
+    if (ep == NULL) return NULL;
+
+    memset(ep, 0, sizeof(DCPEndpoint));
+    ep->alloc_fn = malloc_fn;
+    ep->free_fn = dcp_get_free();
+    ep->user = user;
+
+    if (dcp_endpoint_rehash(ep, DCP_ENDPOINT_INIT_CAP) < 0 ||
+        dcp_endpoint_grow_slots(ep) < 0) {
+        if (ep->table) ep->free_fn(ep->table);
+        ep->free_fn(ep);
+        return NULL;
+    }
+    ep->slot_used = 1;
+
+    return ep;
+}
+
+static void dcp_endpoint_on_release(DCPCB *dcp) {
+    dcp_endpoint_remove(dcp->endpoint, dcp->endpoint_handle);
+}
+
+void dcp_endpoint_release(DCPEndpoint *ep) {
+    if (ep == NULL) return;
+
+    for (uint32_t i = 1; i < ep->slot_used; i++) {
+        DCPCB *dcp = ep->slots[i].dcp;
+        if (dcp != NULL) {
+            dcp->endpoint = NULL;
+            dcp->endpoint_handle = DCP_HANDLE_INVALID;
+            dcp->on_release = NULL;
+        }
+    }
+
+    ep->free_fn(ep->table);
+    ep->free_fn(ep->slots);
+    ep->free_fn(ep);
+}
+
+void dcp_endpoint_set_accept(DCPEndpoint *ep, dcp_accept_callback accept) {
+    if (ep) ep->accept = accept;
+}
+
+DCPHandle dcp_endpoint_add(DCPEndpoint *ep, DCPCB *dcp) {
+    if (ep == NULL || dcp == NULL || dcp->is_released || dcp->endpoint != NULL) {
+        return DCP_HANDLE_INVALID;
+    }
+    if (dcp_endpoint_lookup(ep, dcp->conv_id) != NULL) {
+        return DCP_HANDLE_INVALID;
+    }
+
+    if ((uint64_t)(ep->count + 1) * DCP_ENDPOINT_LOAD_DEN >
+        (uint64_t)(ep->table_mask + 1) * DCP_ENDPOINT_LOAD_NUM) {
+        if (dcp_endpoint_rehash(ep, (ep->table_mask + 1) * 2) < 0) {
+            return DCP_HANDLE_INVALID;
+        }
+    }
+
+    uint32_t index = ep->free_head;
+    if (index != 0) {
+        ep->free_head = ep->slots[index].next_free;
+    } else {
+        if (ep->slot_used == ep->slot_cap && dcp_endpoint_grow_slots(ep) < 0) {
+            return DCP_HANDLE_INVALID;
+        }
+        index = ep->slot_used++;
+        ep->slots[index].generation = 1;
+    }
+
+    DCPEndpointSlot *slot = &ep->slots[index];
+    slot->dcp = dcp;
+    slot->next_free = 0;
+    slot->token = dcp->token;
+    slot->conv_id = dcp->conv_id;
+
+    uint32_t pos = dcp_conv_hash(dcp->conv_id) & ep->table_mask;
+    while (ep->table[pos].slot != 0) {
+        pos = (pos + 1) & ep->table_mask;
+    }
+    ep->table[pos].conv_id = dcp->conv_id;
+    ep->table[pos].slot = index;
+    ep->count++;
+
+    dcp->endpoint = ep;
+    dcp->endpoint_handle = dcp_make_handle(slot->generation, index);
+    dcp->on_release = dcp_endpoint_on_release;
+    return dcp->endpoint_handle;
+}
+
+int dcp_endpoint_remove(DCPEndpoint *ep, DCPHandle handle) {
+    if (ep == NULL) return -1;
+
+    uint32_t index = (uint32_t)handle;
+    uint32_t generation = (uint32_t)(handle >> 32);
+    if (index == 0 || index >= ep->slot_used) return -1;
+
+    DCPEndpointSlot *slot = &ep->slots[index];
+    if (slot->dcp == NULL || slot->generation != generation) return -1;
+
+    DCPEndpointEntry *entry = dcp_endpoint_lookup(ep, slot->conv_id);
+    if (entry != NULL) {
+        dcp_endpoint_erase(ep, entry);
+    }
+    ep->count--;
+
+    slot->dcp->endpoint = NULL;
+    slot->dcp->endpoint_handle = DCP_HANDLE_INVALID;
+    slot->dcp->on_release = NULL;
+    slot->dcp = NULL;
+    if (++slot->generation == 0) slot->generation = 1;
+    slot->next_free = ep->free_head;
+    ep->free_head = index;
+    return 0;
+}
+
+DCPCB* dcp_endpoint_get(const DCPEndpoint *ep, DCPHandle handle) {
+    if (ep == NULL) return NULL;
+
+    uint32_t index = (uint32_t)handle;
+    if (index == 0 || index >= ep->slot_used) return NULL;
+
+    const DCPEndpointSlot *slot = &ep->slots[index];
+    if (slot->generation != (uint32_t)(handle >> 32)) return NULL;
+    return slot->dcp;
+}
+
+DCPCB* dcp_endpoint_find(const DCPEndpoint *ep, uint32_t conv_id, uint32_t token) {
+    if (ep == NULL) return NULL;
+
+    const DCPEndpointEntry *entry = dcp_endpoint_lookup(ep, conv_id);
+    if (entry == NULL) return NULL;
+
+    const DCPEndpointSlot *slot = &ep->slots[entry->slot];
+    return (slot->token == token) ? slot->dcp : NULL;
+}
+
+DCPCB* dcp_endpoint_find_conv(const DCPEndpoint *ep, uint32_t conv_id) {
+    if (ep == NULL) return NULL;
+
+    const DCPEndpointEntry *entry = dcp_endpoint_lookup(ep, conv_id);
+    return entry ? ep->slots[entry->slot].dcp : NULL;
+}
+
+int dcp_endpoint_input(DCPEndpoint *ep, const char *data, long size,
+                       void *from, uint32_t now) {
+    if (ep == NULL || data == NULL || size < (long)DCP_OVERHEAD_MIN) return -1;
+
+    uint32_t conv_id = ((uint32_t)(unsigned char)data[0] << 24) |
+                       ((uint32_t)(unsigned char)data[1] << 16) |
+                       ((uint32_t)(unsigned char)data[2] << 8) |
+                       ((uint32_t)(unsigned char)data[3]);
+
+    DCPCB *dcp = NULL;
+    const DCPEndpointEntry *entry = dcp_endpoint_lookup(ep, conv_id);
+    if (entry != NULL) {
+        dcp = ep->slots[entry->slot].dcp;
+    } else if (ep->accept != NULL) {
+        dcp = ep->accept(ep, conv_id, data, size, from, ep->user);
+        if (dcp == NULL) return -2;
+        if (dcp->endpoint == NULL && dcp_endpoint_add(ep, dcp) == DCP_HANDLE_INVALID) {
+            return -3;
+        }
+    } else {
+        return -2;
+    }
+
+    return dcp_input(dcp, data, size, now);
+}
+
+uint32_t dcp_endpoint_count(const DCPEndpoint *ep) {
+    return ep ? ep->count : 0;
+}
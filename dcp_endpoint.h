@@ -0,0 +1,81 @@
+#ifndef __DCP_ENDPOINT_H__
+#define __DCP_ENDPOINT_H__
+
+#include <stdint.h>
+#include "dcp.h"
+
+#define DCP_ENDPOINT_INIT_CAP    64
+#define DCP_ENDPOINT_LOAD_NUM    3
+#define DCP_ENDPOINT_LOAD_DEN    4
+
+#define DCP_HANDLE_INVALID       0ULL
+
+typedef uint64_t DCPHandle;
+
+static inline uint32_t dcp_conv_hash(uint32_t conv_id) {
+    conv_id ^= conv_id >> 16;
+    conv_id *= 0x7feb352dU;
+    conv_id ^= conv_id >> 15;
+    conv_id *= 0x846ca68bU;
+    conv_id ^= conv_id >> 16;
+    return conv_id;
+}
+
+struct DCPEndpoint;
+
+typedef DCPCB* (*dcp_accept_callback)(struct DCPEndpoint *ep, uint32_t conv_id,
+                                      const char *data, long size, void *from,
+                                      void *user);
+
+typedef struct DCPEndpointEntry {
+    uint32_t conv_id;
+    uint32_t slot;
+} DCPEndpointEntry;
+
+typedef struct DCPEndpointSlot {
+    DCPCB *dcp;
+    uint32_t generation;
+    uint32_t next_free;
+    uint32_t token;
+    uint32_t conv_id;
+} DCPEndpointSlot;
+
+typedef struct DCPEndpoint {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    DCPEndpointEntry *table;
+    uint32_t table_mask;
+    uint32_t count;
+
+    DCPEndpointSlot *slots;
+    uint32_t slot_cap;
+    uint32_t slot_used;
+    uint32_t free_head;
+
+    dcp_accept_callback accept;
+    void *user;
+} DCPEndpoint;
+
+DCPEndpoint* dcp_endpoint_create(void *user);
+
+void dcp_endpoint_release(DCPEndpoint *ep);
+
+void dcp_endpoint_set_accept(DCPEndpoint *ep, dcp_accept_callback accept);
+
+DCPHandle dcp_endpoint_add(DCPEndpoint *ep, DCPCB *dcp);
+
+int dcp_endpoint_remove(DCPEndpoint *ep, DCPHandle handle);
+
+DCPCB* dcp_endpoint_get(const DCPEndpoint *ep, DCPHandle handle);
+
+DCPCB* dcp_endpoint_find(const DCPEndpoint *ep, uint32_t conv_id, uint32_t token);
+
+DCPCB* dcp_endpoint_find_conv(const DCPEndpoint *ep, uint32_t conv_id);
+
+int dcp_endpoint_input(DCPEndpoint *ep, const char *data, long size,
+                       void *from, uint32_t now);
+
+uint32_t dcp_endpoint_count(const DCPEndpoint *ep);
+
+#endif
@@ -0,0 +1,517 @@
+#include "dcp_fec.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DCP_FEC_X86 1
+#endif
+
+#define DCP_GF_POLY             0x11D
+#define DCP_FEC_MIN_WINDOW      (2 * DCP_FEC_MAX_DATA)
+
+typedef void (*dcp_gf_kernel_fn)(uint8_t *dst, const uint8_t *src, const uint8_t *tbl, size_t len);
+
+static uint8_t dcp_gf_exp[512];
+static uint8_t dcp_gf_log[256];
+static uint8_t dcp_gf_tbl[256][32];
+static uint8_t dcp_fec_coefs[DCP_FEC_MAX_PARITY][DCP_FEC_MAX_DATA];
+static dcp_gf_kernel_fn dcp_gf_kernel;
+static int dcp_gf_level;
+static int dcp_gf_max_level;
+static pthread_once_t dcp_gf_once = PTHREAD_ONCE_INIT;
+
+static void dcp_gf_mul_add_scalar(uint8_t *dst, const uint8_t *src, const uint8_t *tbl, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] ^= tbl[src[i] & 0x0F] ^ tbl[16 + (src[i] >> 4)];
+    }
+}
+
+#ifdef DCP_FEC_X86
+__attribute__((target("ssse3")))
+static void dcp_gf_mul_add_ssse3(uint8_t *dst, const uint8_t *src, const uint8_t *tbl, size_t len) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)tbl);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(tbl + 16));
+    __m128i mask = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+    }
+    dcp_gf_mul_add_scalar(dst + i, src + i, tbl, len - i);
+}
+
+__attribute__((target("avx2")))
+static void dcp_gf_mul_add_avx2(uint8_t *dst, const uint8_t *src, const uint8_t *tbl, size_t len) {
+    __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tbl));
+    __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(tbl + 16)));
+    __m256i mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(l, h)));
+    }
+    if (i + 16 <= len) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i l = _mm_shuffle_epi8(_mm256_castsi256_si128(lo), _mm_and_si128(s, _mm256_castsi256_si128(mask)));
+        __m128i h = _mm_shuffle_epi8(_mm256_castsi256_si128(hi),
+                                     _mm_and_si128(_mm_srli_epi64(s, 4), _mm256_castsi256_si128(mask)));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+        i += 16;
+    }
+    _mm256_zeroupper();
+    dcp_gf_mul_add_scalar(dst + i, src + i, tbl, len - i);
+}
+#endif
+
+static uint8_t dcp_gf_mul_slow(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) return 0;
+    return dcp_gf_exp[dcp_gf_log[a] + dcp_gf_log[b]];
+}
+
+static void dcp_gf_select(int level) {
+    if (level > dcp_gf_max_level) level = dcp_gf_max_level;
+    if (level < DCP_FEC_SIMD_SCALAR) level = DCP_FEC_SIMD_SCALAR;
+
+    dcp_gf_kernel = dcp_gf_mul_add_scalar;
+#ifdef DCP_FEC_X86
+    if (level == DCP_FEC_SIMD_SSSE3) dcp_gf_kernel = dcp_gf_mul_add_ssse3;
+    if (level == DCP_FEC_SIMD_AVX2) dcp_gf_kernel = dcp_gf_mul_add_avx2;
+#endif
+    dcp_gf_level = level;
+}
+
+static void dcp_gf_init_once(void) {
+    uint32_t x = 1;
+    for (int i = 0; i < 255; i++) {
+        dcp_gf_exp[i] = (uint8_t)x;
+        dcp_gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) x ^= DCP_GF_POLY;
+    }
+    for (int i = 255; i < 512; i++) {
+        dcp_gf_exp[i] = dcp_gf_exp[i - 255];
+    }
+
+    for (int c = 0; c < 256; c++) {
+        for (int n = 0; n < 16; n++) {
+            dcp_gf_tbl[c][n] = dcp_gf_mul_slow((uint8_t)c, (uint8_t)n);
+            dcp_gf_tbl[c][16 + n] = dcp_gf_mul_slow((uint8_t)c, (uint8_t)(n << 4));
+        }
+    }
+
+    for (uint32_t j = 0; j < DCP_FEC_MAX_PARITY; j++) {
+        for (uint32_t i = 0; i < DCP_FEC_MAX_DATA; i++) {
+            uint8_t v = (uint8_t)((DCP_FEC_MAX_DATA + j) ^ i);
+            dcp_fec_coefs[j][i] = dcp_gf_exp[255 - dcp_gf_log[v]];
+        }
+    }
+
+    dcp_gf_max_level = DCP_FEC_SIMD_SCALAR;
+#if defined(DCP_FEC_X86) && !defined(DCP_FEC_NO_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) dcp_gf_max_level = DCP_FEC_SIMD_SSSE3;
+    if (__builtin_cpu_supports("avx2")) dcp_gf_max_level = DCP_FEC_SIMD_AVX2;
+#endif
+    dcp_gf_select(dcp_gf_max_level);
+}
+
+static inline void dcp_gf_init(void) {
+    pthread_once(&dcp_gf_once, dcp_gf_init_once);
+}
+
+uint8_t dcp_gf_mul(uint8_t a, uint8_t b) {
+    dcp_gf_init();
+    return dcp_gf_mul_slow(a, b);
+}
+
+uint8_t dcp_gf_inv(uint8_t a) {
+    if (a == 0) return 0;
+    dcp_gf_init();
+    return dcp_gf_exp[255 - dcp_gf_log[a]];
+}
+
+void dcp_gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+    if (c == 0 || len == 0) return;
+    dcp_gf_init();
+    dcp_gf_kernel(dst, src, dcp_gf_tbl[c], len);
+}
+
+int dcp_fec_simd_level(void) {
+    dcp_gf_init();
+    return dcp_gf_level;
+}
+
+int dcp_fec_set_simd(int level) {
+    dcp_gf_init();
+    dcp_gf_select(level);
+    return dcp_gf_level;
+}
+
+uint8_t dcp_fec_coef(uint32_t parity, uint32_t index) {
+    if (parity >= DCP_FEC_MAX_PARITY || index >= DCP_FEC_MAX_DATA) return 0;
+    dcp_gf_init();
+    return dcp_fec_coefs[parity][index];
+}
+
+int dcp_fec_recover(uint8_t **symbols, const uint8_t *present, uint32_t k,
+                    uint8_t **parity, const uint32_t *parity_idx, uint32_t nparity,
+                    uint32_t sym_len) {
+    uint32_t missing[DCP_FEC_MAX_PARITY];
+    uint8_t mat[DCP_FEC_MAX_PARITY][2 * DCP_FEC_MAX_PARITY];
+    uint32_t nmiss = 0;
+
+    if (k == 0 || k > DCP_FEC_MAX_DATA) return -1;
+    dcp_gf_init();
+
+    for (uint32_t i = 0; i < k; i++) {
+        if (present[i]) continue;
+        if (nmiss == DCP_FEC_MAX_PARITY) return -1;
+        missing[nmiss++] = i;
+    }
+    if (nmiss == 0) return 0;
+    if (nmiss > nparity) return -1;
+
+    for (uint32_t r = 0; r < nmiss; r++) {
+        uint32_t j = parity_idx[r];
+        if (j >= DCP_FEC_MAX_PARITY) return -1;
+        for (uint32_t i = 0; i < k; i++) {
+            if (present[i]) {
+                dcp_gf_kernel(parity[r], symbols[i], dcp_gf_tbl[dcp_fec_coefs[j][i]], sym_len);
+            }
+        }
+        for (uint32_t c = 0; c < nmiss; c++) {
+            mat[r][c] = dcp_fec_coefs[j][missing[c]];
+            mat[r][nmiss + c] = (r == c) ? 1 : 0;
+        }
+    }
+
+    for (uint32_t c = 0; c < nmiss; c++) {
+        uint32_t p = c;
+        while (p < nmiss && mat[p][c] == 0) p++;
+        if (p == nmiss) return -1;
+        if (p != c) {
+            for (uint32_t n = 0; n < 2 * nmiss; n++) {
+                uint8_t t = mat[c][n];
+                mat[c][n] = mat[p][n];
+                mat[p][n] = t;
+            }
+        }
+
+        uint8_t inv = dcp_gf_exp[255 - dcp_gf_log[mat[c][c]]];
+        for (uint32_t n = 0; n < 2 * nmiss; n++) {
+            mat[c][n] = dcp_gf_mul_slow(mat[c][n], inv);
+        }
+        for (uint32_t r = 0; r < nmiss; r++) {
+            uint8_t f = mat[r][c];
+            if (r == c || f == 0) continue;
+            for (uint32_t n = 0; n < 2 * nmiss; n++) {
+                mat[r][n] ^= dcp_gf_mul_slow(f, mat[c][n]);
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < nmiss; c++) {
+        uint8_t *out = symbols[missing[c]];
+        memset(out, 0, sym_len);
+        for (uint32_t r = 0; r < nmiss; r++) {
+            uint8_t f = mat[c][nmiss + r];
+            if (f != 0) dcp_gf_kernel(out, parity[r], dcp_gf_tbl[f], sym_len);
+        }
+    }
+
+    return (int)nmiss;
+}
+
+DCPFecEncoder* dcp_fec_encoder_create(uint32_t k, uint32_t m, uint32_t sym_cap) {
+    if (k == 0 || k > DCP_FEC_MAX_DATA || m == 0 || m > DCP_FEC_MAX_PARITY) return NULL;
+    if (sym_cap <= DCP_FEC_SYM_HDR || sym_cap > DCP_FEC_SYM_HDR + 0xFFFF) return NULL;
+
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+    DCPFecEncoder *enc = (DCPFecEncoder*)malloc_fn(sizeof(DCPFecEncoder));
+    if (enc == NULL) return NULL;
+
+    memset(enc, 0, sizeof(DCPFecEncoder));
+    enc->alloc_fn = malloc_fn;
+    enc->free_fn = dcp_get_free();
+    enc->k = k;
+    enc->m = m;
+    enc->sym_cap = sym_cap;
+
+    enc->parity = (uint8_t*)malloc_fn((size_t)m * sym_cap);
+    if (enc->parity == NULL) {
+        enc->free_fn(enc);
+        return NULL;
+    }
+    memset(enc->parity, 0, (size_t)m * sym_cap);
+    dcp_gf_init();
+
+    return enc;
+}
+
+void dcp_fec_encoder_release(DCPFecEncoder *enc) {
+    if (enc == NULL) return;
+    enc->free_fn(enc->parity);
+    enc->free_fn(enc);
+}
+
+static void dcp_fec_sym_header(uint8_t *hdr, uint32_t frg, uint32_t len) {
+    hdr[0] = (uint8_t)frg;
+    hdr[1] = (uint8_t)(frg >> 8);
+    hdr[2] = (uint8_t)(frg >> 16);
+    hdr[3] = (uint8_t)(frg >> 24);
+    hdr[4] = (uint8_t)len;
+    hdr[5] = (uint8_t)(len >> 8);
+}
+
+int dcp_fec_encode(DCPFecEncoder *enc, uint32_t sn, uint32_t frg,
+                   const char *data, uint32_t len) {
+    uint8_t hdr[DCP_FEC_SYM_HDR];
+
+    if (enc == NULL || enc->count >= enc->k) return -1;
+    if (len + DCP_FEC_SYM_HDR > enc->sym_cap) return -2;
+    if (enc->count == 0) {
+        enc->base_sn = sn;
+    } else if (sn != enc->base_sn + enc->count) {
+        return -3;
+    }
+
+    dcp_fec_sym_header(hdr, frg, len);
+    for (uint32_t j = 0; j < enc->m; j++) {
+        uint8_t *p = enc->parity + (size_t)j * enc->sym_cap;
+        const uint8_t *tbl = dcp_gf_tbl[dcp_fec_coefs[j][enc->count]];
+        dcp_gf_mul_add_scalar(p, hdr, tbl, DCP_FEC_SYM_HDR);
+        dcp_gf_kernel(p + DCP_FEC_SYM_HDR, (const uint8_t*)data, tbl, len);
+    }
+
+    if (len + DCP_FEC_SYM_HDR > enc->sym_len) enc->sym_len = len + DCP_FEC_SYM_HDR;
+    enc->count++;
+    return (enc->count == enc->k) ? 1 : 0;
+}
+
+const uint8_t* dcp_fec_encoder_parity(const DCPFecEncoder *enc, uint32_t index) {
+    if (enc == NULL || index >= enc->m) return NULL;
+    return enc->parity + (size_t)index * enc->sym_cap;
+}
+
+void dcp_fec_encoder_reset(DCPFecEncoder *enc) {
+    if (enc == NULL) return;
+    for (uint32_t j = 0; j < enc->m; j++) {
+        memset(enc->parity + (size_t)j * enc->sym_cap, 0, enc->sym_len);
+    }
+    enc->count = 0;
+    enc->sym_len = 0;
+}
+
+DCPFecDecoder* dcp_fec_decoder_create(uint32_t sym_cap, uint32_t window) {
+    if (sym_cap <= DCP_FEC_SYM_HDR || sym_cap > DCP_FEC_SYM_HDR + 0xFFFF) return NULL;
+
+    uint32_t entries = DCP_FEC_MIN_WINDOW;
+    while (entries < window) {
+        if (entries >= (1u << 16)) return NULL;
+        entries <<= 1;
+    }
+
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+    DCPFecDecoder *dec = (DCPFecDecoder*)malloc_fn(sizeof(DCPFecDecoder));
+    if (dec == NULL) return NULL;
+
+    memset(dec, 0, sizeof(DCPFecDecoder));
+    dec->alloc_fn = malloc_fn;
+    dec->free_fn = dcp_get_free();
+    dec->sym_cap = sym_cap;
+    dec->cache_mask = entries - 1;
+
+    dec->cache_sn = (uint32_t*)malloc_fn(entries * sizeof(uint32_t));
+    dec->cache_len = (uint32_t*)malloc_fn(entries * sizeof(uint32_t));
+    dec->cache = (uint8_t*)malloc_fn((size_t)entries * sym_cap);
+    for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+        dec->groups[i].parity = (uint8_t*)malloc_fn((size_t)DCP_FEC_MAX_PARITY * sym_cap);
+    }
+
+    int failed = (dec->cache_sn == NULL || dec->cache_len == NULL || dec->cache == NULL);
+    for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+        if (dec->groups[i].parity == NULL) failed = 1;
+    }
+    if (failed) {
+        dcp_fec_decoder_release(dec);
+        return NULL;
+    }
+
+    memset(dec->cache_sn, 0, entries * sizeof(uint32_t));
+    memset(dec->cache_len, 0, entries * sizeof(uint32_t));
+    dcp_gf_init();
+
+    return dec;
+}
+
+void dcp_fec_decoder_release(DCPFecDecoder *dec) {
+    if (dec == NULL) return;
+    for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+        if (dec->groups[i].parity) dec->free_fn(dec->groups[i].parity);
+    }
+    if (dec->cache) dec->free_fn(dec->cache);
+    if (dec->cache_len) dec->free_fn(dec->cache_len);
+    if (dec->cache_sn) dec->free_fn(dec->cache_sn);
+    dec->free_fn(dec);
+}
+
+void dcp_fec_decoder_store(DCPFecDecoder *dec, uint32_t sn, uint32_t frg,
+                           const char *data, uint32_t len) {
+    if (dec == NULL || len + DCP_FEC_SYM_HDR > dec->sym_cap) return;
+
+    uint32_t slot = sn & dec->cache_mask;
+    uint8_t *sym = dec->cache + (size_t)slot * dec->sym_cap;
+
+    if (dec->cache_len[slot] != 0 && dec->cache_sn[slot] == sn) return;
+
+    dcp_fec_sym_header(sym, frg, len);
+    memcpy(sym + DCP_FEC_SYM_HDR, data, len);
+    memset(sym + DCP_FEC_SYM_HDR + len, 0, dec->sym_cap - DCP_FEC_SYM_HDR - len);
+    dec->cache_sn[slot] = sn;
+    dec->cache_len[slot] = len + DCP_FEC_SYM_HDR;
+}
+
+const uint8_t* dcp_fec_decoder_lookup(const DCPFecDecoder *dec, uint32_t sn,
+                                      uint32_t *frg, uint32_t *len) {
+    if (dec == NULL) return NULL;
+
+    uint32_t slot = sn & dec->cache_mask;
+    if (dec->cache_len[slot] == 0 || dec->cache_sn[slot] != sn) return NULL;
+
+    const uint8_t *sym = dec->cache + (size_t)slot * dec->sym_cap;
+    if (frg) *frg = (uint32_t)sym[0] | ((uint32_t)sym[1] << 8) |
+                    ((uint32_t)sym[2] << 16) | ((uint32_t)sym[3] << 24);
+    if (len) *len = dec->cache_len[slot] - DCP_FEC_SYM_HDR;
+    return sym + DCP_FEC_SYM_HDR;
+}
+
+int dcp_fec_decoder_parity(DCPFecDecoder *dec, uint32_t base_sn, uint32_t k, uint32_t index,
+                           const char *parity, uint32_t len) {
+    if (dec == NULL || k == 0 || k > DCP_FEC_MAX_DATA || index >= DCP_FEC_MAX_PARITY) return -1;
+    if (len <= DCP_FEC_SYM_HDR || len > dec->sym_cap) return -1;
+
+    int g = -1;
+    for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+        if (dec->groups[i].k != 0 && dec->groups[i].base_sn == base_sn) {
+            g = i;
+            break;
+        }
+    }
+
+    if (g < 0) {
+        for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+            if (dec->groups[i].k == 0) {
+                g = i;
+                break;
+            }
+        }
+        if (g < 0) {
+            g = (int)dec->next_group;
+            dec->next_group = (dec->next_group + 1) % DCP_FEC_GROUPS;
+        }
+        dec->groups[g].base_sn = base_sn;
+        dec->groups[g].k = k;
+        dec->groups[g].sym_len = len;
+        dec->groups[g].parity_mask = 0;
+    }
+
+    DCPFecGroup *group = &dec->groups[g];
+    if (group->k != k || group->sym_len != len) return -1;
+
+    if ((group->parity_mask & (1u << index)) == 0) {
+        memcpy(group->parity + (size_t)index * dec->sym_cap, parity, len);
+        group->parity_mask |= 1u << index;
+    }
+    return g;
+}
+
+int dcp_fec_decoder_find(const DCPFecDecoder *dec, uint32_t sn) {
+    if (dec == NULL) return -1;
+    for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+        const DCPFecGroup *group = &dec->groups[i];
+        if (group->k != 0 && sn - group->base_sn < group->k) return i;
+    }
+    return -1;
+}
+
+uint32_t dcp_fec_decoder_recover(DCPFecDecoder *dec, int group_index, uint32_t *base_sn) {
+    uint8_t *symbols[DCP_FEC_MAX_DATA];
+    uint8_t present[DCP_FEC_MAX_DATA];
+    uint8_t *parity[DCP_FEC_MAX_PARITY];
+    uint32_t parity_idx[DCP_FEC_MAX_PARITY];
+    uint32_t nmiss = 0, nparity = 0;
+
+    if (dec == NULL || group_index < 0 || group_index >= DCP_FEC_GROUPS) return 0;
+
+    DCPFecGroup *group = &dec->groups[group_index];
+    if (group->k == 0) return 0;
+
+    for (uint32_t i = 0; i < group->k; i++) {
+        uint32_t sn = group->base_sn + i;
+        uint32_t slot = sn & dec->cache_mask;
+        symbols[i] = dec->cache + (size_t)slot * dec->sym_cap;
+        present[i] = (dec->cache_len[slot] != 0 && dec->cache_sn[slot] == sn &&
+                      dec->cache_len[slot] <= group->sym_len);
+        if (!present[i]) nmiss++;
+    }
+
+    if (nmiss == 0) {
+        group->k = 0;
+        return 0;
+    }
+
+    for (uint32_t j = 0; j < DCP_FEC_MAX_PARITY; j++) {
+        if (group->parity_mask & (1u << j)) {
+            parity[nparity] = group->parity + (size_t)j * dec->sym_cap;
+            parity_idx[nparity] = j;
+            nparity++;
+        }
+    }
+    if (nmiss > nparity) return 0;
+
+    uint32_t k = group->k;
+    uint32_t base = group->base_sn;
+    group->k = 0;
+
+    if (dcp_fec_recover(symbols, present, k, parity, parity_idx, nparity, group->sym_len) <= 0) {
+        return 0;
+    }
+
+    uint32_t recovered = 0;
+    for (uint32_t i = 0; i < k; i++) {
+        if (present[i]) continue;
+        uint32_t slot = (base + i) & dec->cache_mask;
+        uint32_t len = (uint32_t)symbols[i][4] | ((uint32_t)symbols[i][5] << 8);
+        if (len + DCP_FEC_SYM_HDR > group->sym_len) {
+            dec->cache_len[slot] = 0;
+            continue;
+        }
+        memset(symbols[i] + group->sym_len, 0, dec->sym_cap - group->sym_len);
+        dec->cache_sn[slot] = base + i;
+        dec->cache_len[slot] = len + DCP_FEC_SYM_HDR;
+        recovered |= 1u << i;
+    }
+
+    if (base_sn) *base_sn = base;
+    return recovered;
+}
+
+void dcp_fec_decoder_expire(DCPFecDecoder *dec, uint32_t rcv_nxt) {
+    if (dec == NULL) return;
+    for (int i = 0; i < DCP_FEC_GROUPS; i++) {
+        DCPFecGroup *group = &dec->groups[i];
+        if (group->k != 0 && (int32_t)(group->base_sn + group->k - rcv_nxt) <= 0) {
+            group->k = 0;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef __DCP_FEC_H__
+#define __DCP_FEC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dcp_allocator.h"
+
+#define DCP_FEC_MAX_DATA     32
+#define DCP_FEC_MAX_PARITY   4
+#define DCP_FEC_GROUPS       4
+#define DCP_FEC_SYM_HDR      6
+#define DCP_FEC_HDR          4
+#define DCP_FEC_OVERHEAD     (DCP_FEC_SYM_HDR + DCP_FEC_HDR)
+
+#define DCP_FEC_SIMD_SCALAR  0
+#define DCP_FEC_SIMD_SSSE3   1
+#define DCP_FEC_SIMD_AVX2    2
+
+typedef struct DCPFecEncoder {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    uint32_t k;
+    uint32_t m;
+    uint32_t sym_cap;
+
+    uint32_t base_sn;
+    uint32_t count;
+    uint32_t sym_len;
+    uint8_t *parity;
+} DCPFecEncoder;
+
+typedef struct DCPFecGroup {
+    uint32_t base_sn;
+    uint32_t k;
+    uint32_t sym_len;
+    uint32_t parity_mask;
+    uint8_t *parity;
+} DCPFecGroup;
+
+typedef struct DCPFecDecoder {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    uint32_t sym_cap;
+    uint32_t cache_mask;
+    uint32_t *cache_sn;
+    uint32_t *cache_len;
+    uint8_t *cache;
+
+    DCPFecGroup groups[DCP_FEC_GROUPS];
+    uint32_t next_group;
+} DCPFecDecoder;
+
+uint8_t dcp_gf_mul(uint8_t a, uint8_t b);
+
+uint8_t dcp_gf_inv(uint8_t a);
+
+void dcp_gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len);
+
+int dcp_fec_simd_level(void);
+
+int dcp_fec_set_simd(int level);
+
+uint8_t dcp_fec_coef(uint32_t parity, uint32_t index);
+
+int dcp_fec_recover(uint8_t **symbols, const uint8_t *present, uint32_t k,
+                    uint8_t **parity, const uint32_t *parity_idx, uint32_t nparity,
+                    uint32_t sym_len);
+
+DCPFecEncoder* dcp_fec_encoder_create(uint32_t k, uint32_t m, uint32_t sym_cap);
+
+void dcp_fec_encoder_release(DCPFecEncoder *enc);
+
+int dcp_fec_encode(DCPFecEncoder *enc, uint32_t sn, uint32_t frg,
+                   const char *data, uint32_t len);
+
+const uint8_t* dcp_fec_encoder_parity(const DCPFecEncoder *enc, uint32_t index);
+
+void dcp_fec_encoder_reset(DCPFecEncoder *enc);
+
+DCPFecDecoder* dcp_fec_decoder_create(uint32_t sym_cap, uint32_t window);
+
+void dcp_fec_decoder_release(DCPFecDecoder *dec);
+
+void dcp_fec_decoder_store(DCPFecDecoder *dec, uint32_t sn, uint32_t frg,
+                           const char *data, uint32_t len);
+
+const uint8_t* dcp_fec_decoder_lookup(const DCPFecDecoder *dec, uint32_t sn,
+                                      uint32_t *frg, uint32_t *len);
+
+int dcp_fec_decoder_parity(DCPFecDecoder *dec, uint32_t base_sn, uint32_t k, uint32_t index,
+                           const char *parity, uint32_t len);
+
+int dcp_fec_decoder_find(const DCPFecDecoder *dec, uint32_t sn);
+
+uint32_t dcp_fec_decoder_recover(DCPFecDecoder *dec, int group, uint32_t *base_sn);
+
+void dcp_fec_decoder_expire(DCPFecDecoder *dec, uint32_t rcv_nxt);
+
+#endif
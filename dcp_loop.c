@@ -0,0 +1,151 @@
+#include "dcp_loop.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+static uint64_t dcp_loop_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void dcp_loop_on_wakeup(DCPScheduler *scheduler, void *arg) {
+    (void)scheduler;
+    dcp_loop_wakeup((DCPLoop*)arg);
+}
+
+DCPLoop* dcp_loop_create(DCPScheduler *scheduler) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    if (scheduler == NULL) return NULL;
+
+    DCPLoop *loop = (DCPLoop*)malloc_fn(sizeof(DCPLoop));
+    if (loop == NULL) return NULL;
+
+    memset(loop, 0, sizeof(DCPLoop));
+    loop->alloc_fn = malloc_fn;
+    loop->free_fn = dcp_get_free();
+    loop->scheduler = scheduler;
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (loop->epoll_fd < 0 || loop->timer.fd < 0 || loop->wake.fd < 0 ||
+        dcp_loop_add(loop, &loop->timer, EPOLLIN) < 0 ||
+        dcp_loop_add(loop, &loop->wake, EPOLLIN) < 0) {
+        if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+        if (loop->timer.fd >= 0) close(loop->timer.fd);
+        if (loop->wake.fd >= 0) close(loop->wake.fd);
+        loop->free_fn(loop);
+        return NULL;
+    }
+
+    dcp_scheduler_set_wakeup(scheduler, dcp_loop_on_wakeup, loop);
+    return loop;
+}
+
+void dcp_loop_release(DCPLoop *loop) {
+    if (loop == NULL) return;
+
+    if (loop->scheduler->wakeup_arg == loop) {
+        dcp_scheduler_set_wakeup(loop->scheduler, NULL, NULL);
+    }
+    close(loop->epoll_fd);
+    close(loop->timer.fd);
+    close(loop->wake.fd);
+    loop->free_fn(loop);
+}
+
+int dcp_loop_add(DCPLoop *loop, DCPLoopWatch *watch, uint32_t events) {
+    struct epoll_event ev;
+
+    if (loop == NULL || watch == NULL || watch->fd < 0) return -1;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = watch;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, watch->fd, &ev) < 0 ? -2 : 0;
+}
+
+int dcp_loop_modify(DCPLoop *loop, DCPLoopWatch *watch, uint32_t events) {
+    struct epoll_event ev;
+
+    if (loop == NULL || watch == NULL || watch->fd < 0) return -1;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = watch;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, watch->fd, &ev) < 0 ? -2 : 0;
+}
+
+int dcp_loop_remove(DCPLoop *loop, DCPLoopWatch *watch) {
+    if (loop == NULL || watch == NULL || watch->fd < 0) return -1;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL) < 0 ? -2 : 0;
+}
+
+int dcp_loop_arm(DCPLoop *loop) {
+    struct itimerspec its;
+
+    uint64_t expiry = dcp_scheduler_next_expiry_us(loop->scheduler);
+    if (expiry == DCP_TIMER_NONE) expiry = 0;
+    if (expiry == loop->armed_us) return 0;
+
+    memset(&its, 0, sizeof(its));
+    if (expiry != 0) {
+        its.it_value.tv_sec = (time_t)(expiry / 1000000);
+        its.it_value.tv_nsec = (long)(expiry % 1000000) * 1000;
+    }
+    if (timerfd_settime(loop->timer.fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) return -1;
+
+    loop->armed_us = expiry;
+    return 0;
+}
+
+void dcp_loop_wakeup(DCPLoop *loop) {
+    uint64_t one = 1;
+    ssize_t ret;
+
+    do {
+        ret = write(loop->wake.fd, &one, sizeof(one));
+    } while (ret < 0 && errno == EINTR);
+}
+
+int dcp_loop_run_once(DCPLoop *loop, int max_wait_ms) {
+    struct epoll_event events[DCP_LOOP_MAX_EVENTS];
+    uint64_t value;
+
+    if (loop == NULL) return -1;
+
+    if (dcp_loop_arm(loop) < 0) return -2;
+    if (dcp_scheduler_next_timeout(loop->scheduler, dcp_loop_clock_us()) == 0) {
+        max_wait_ms = 0;
+    }
+
+    int n = epoll_wait(loop->epoll_fd, events, DCP_LOOP_MAX_EVENTS, max_wait_ms);
+    if (n < 0) {
+        if (errno != EINTR) return -3;
+        n = 0;
+    }
+
+    uint64_t now_us = dcp_loop_clock_us();
+    dcp_scheduler_run_us(loop->scheduler, now_us);
+    for (int i = 0; i < n; i++) {
+        DCPLoopWatch *watch = (DCPLoopWatch*)events[i].data.ptr;
+        if (watch == &loop->timer) {
+            if (read(loop->timer.fd, &value, sizeof(value)) > 0) loop->timer_fires++;
+            loop->armed_us = 0;
+        } else if (watch == &loop->wake) {
+            if (read(loop->wake.fd, &value, sizeof(value)) > 0) loop->wakeups++;
+        } else if (watch->callback != NULL) {
+            watch->callback(loop, watch, events[i].events, now_us);
+        }
+    }
+
+    dcp_scheduler_run_us(loop->scheduler, now_us);
+    return n;
+}
@@ -0,0 +1,52 @@
+#ifndef __DCP_LOOP_H__
+#define __DCP_LOOP_H__
+
+#include <stdint.h>
+#include "dcp_scheduler.h"
+
+#define DCP_LOOP_MAX_EVENTS   64
+
+struct DCPLoop;
+struct DCPLoopWatch;
+
+typedef void (*dcp_loop_callback)(struct DCPLoop *loop, struct DCPLoopWatch *watch,
+                                  uint32_t events, uint64_t now_us);
+
+typedef struct DCPLoopWatch {
+    int fd;
+    dcp_loop_callback callback;
+    void *arg;
+} DCPLoopWatch;
+
+typedef struct DCPLoop {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    DCPScheduler *scheduler;
+
+    int epoll_fd;
+    DCPLoopWatch timer;
+    DCPLoopWatch wake;
+    uint64_t armed_us;
+
+    uint64_t wakeups;
+    uint64_t timer_fires;
+} DCPLoop;
+
+DCPLoop* dcp_loop_create(DCPScheduler *scheduler);
+
+void dcp_loop_release(DCPLoop *loop);
+
+int dcp_loop_add(DCPLoop *loop, DCPLoopWatch *watch, uint32_t events);
+
+int dcp_loop_modify(DCPLoop *loop, DCPLoopWatch *watch, uint32_t events);
+
+int dcp_loop_remove(DCPLoop *loop, DCPLoopWatch *watch);
+
+int dcp_loop_arm(DCPLoop *loop);
+
+int dcp_loop_run_once(DCPLoop *loop, int max_wait_ms);
+
+void dcp_loop_wakeup(DCPLoop *loop);
+
+#endif
@@ -0,0 +1,274 @@
+#include "dcp_runtime.h"
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct DCPSendTask {
+    DCPTask task;
+    DCPShard *shard;
+    struct DCPSendTask *next;
+    struct DCPSendTask *tail;
+    struct DCPSendTask *next_conv;
+    uint32_t conv_id;
+    int len;
+    char data[1];
+} DCPSendTask;
+
+static void dcp_backlog_task_run(DCPScheduler *scheduler, DCPTask *task, uint32_t now);
+
+uint64_t dcp_runtime_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+DCPRuntime* dcp_runtime_create(int shard_count) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    if (shard_count <= 0 || shard_count > DCP_RUNTIME_MAX_SHARDS) return NULL;
+
+    DCPRuntime *rt = (DCPRuntime*)malloc_fn(sizeof(DCPRuntime));
+    if (rt == NULL) return NULL;
+
+    memset(rt, 0, sizeof(DCPRuntime));
+    rt->alloc_fn = malloc_fn;
+    rt->free_fn = dcp_get_free();
+
+    rt->shards = (DCPShard*)malloc_fn(shard_count * sizeof(DCPShard));
+    if (rt->shards == NULL) {
+        rt->free_fn(rt);
+        return NULL;
+    }
+    memset(rt->shards, 0, shard_count * sizeof(DCPShard));
+
+    for (int i = 0; i < shard_count; i++) {
+        DCPShard *shard = &rt->shards[i];
+        shard->runtime = rt;
+        shard->index = i;
+        shard->backlog_task.run = dcp_backlog_task_run;
+        shard->scheduler = dcp_scheduler_create();
+        shard->endpoint = dcp_endpoint_create(shard);
+        rt->shard_count = i + 1;
+        if (shard->scheduler == NULL || shard->endpoint == NULL) {
+            dcp_runtime_release(rt);
+            return NULL;
+        }
+    }
+
+    return rt;
+}
+
+void dcp_runtime_release(DCPRuntime *rt) {
+    if (rt == NULL) return;
+
+    dcp_runtime_stop(rt);
+
+    for (int i = 0; i < rt->shard_count; i++) {
+        DCPShard *shard = &rt->shards[i];
+        while (shard->backlog != NULL) {
+            DCPSendTask *head = shard->backlog;
+            shard->backlog = head->next_conv;
+            while (head != NULL) {
+                DCPSendTask *next = head->next;
+                rt->free_fn(head);
+                head = next;
+            }
+        }
+    }
+
+    for (int i = 0; i < rt->shard_count; i++) {
+        dcp_endpoint_release(rt->shards[i].endpoint);
+        dcp_scheduler_release(rt->shards[i].scheduler);
+    }
+
+    rt->free_fn(rt->shards);
+    rt->free_fn(rt);
+}
+
+int dcp_runtime_shard_index(const DCPRuntime *rt, uint32_t conv_id) {
+    return (int)(((uint64_t)dcp_conv_hash(conv_id) * (uint32_t)rt->shard_count) >> 32);
+}
+
+DCPShard* dcp_runtime_shard(DCPRuntime *rt, uint32_t conv_id) {
+    if (rt == NULL) return NULL;
+    return &rt->shards[dcp_runtime_shard_index(rt, conv_id)];
+}
+
+int dcp_runtime_post(DCPRuntime *rt, uint32_t conv_id, DCPTask *task) {
+    if (rt == NULL || task == NULL || task->run == NULL) return -1;
+
+    DCPShard *shard = dcp_runtime_shard(rt, conv_id);
+    __atomic_fetch_add(&shard->posted, 1, __ATOMIC_RELAXED);
+    dcp_scheduler_post(shard->scheduler, task);
+    return 0;
+}
+
+static int dcp_send_task_try(DCPShard *shard, DCPCB *dcp, DCPSendTask *st, uint32_t now) {
+    int ret = dcp_send(dcp, st->data, st->len, now);
+    if (ret == -2 && dcp->snd_queue_len + dcp->snd_buf_len > 0) return -2;
+    if (ret != 0) shard->send_dropped++;
+    shard->runtime->free_fn(st);
+    return 0;
+}
+
+static DCPSendTask* dcp_backlog_drain(DCPShard *shard, DCPSendTask *head, uint32_t now) {
+    DCPCB *dcp = dcp_endpoint_find_conv(shard->endpoint, head->conv_id);
+    DCPSendTask *tail = head->tail;
+    DCPSendTask *st = head;
+
+    if (dcp == NULL || dcp->send_backlog != head) {
+        while (st != NULL) {
+            DCPSendTask *next = st->next;
+            shard->send_dropped++;
+            shard->runtime->free_fn(st);
+            st = next;
+        }
+        return NULL;
+    }
+
+    while (st != NULL) {
+        DCPSendTask *next = st->next;
+        if (dcp_send_task_try(shard, dcp, st, now) != 0) break;
+        st = next;
+    }
+    if (st != NULL) st->tail = tail;
+    dcp->send_backlog = st;
+    return st;
+}
+
+static void dcp_backlog_task_run(DCPScheduler *scheduler, DCPTask *task, uint32_t now) {
+    DCPShard *shard = (DCPShard*)((char*)task - offsetof(DCPShard, backlog_task));
+    DCPSendTask **link = &shard->backlog;
+
+    while (*link != NULL) {
+        DCPSendTask *head = *link;
+        DCPSendTask *next_conv = head->next_conv;
+        DCPSendTask *rest = dcp_backlog_drain(shard, head, now);
+        if (rest != NULL) {
+            rest->next_conv = next_conv;
+            *link = rest;
+            link = &rest->next_conv;
+        } else {
+            *link = next_conv;
+        }
+    }
+    if (shard->backlog == NULL) {
+        dcp_scheduler_remove_flush(scheduler, task);
+    }
+}
+
+static void dcp_send_task_run(DCPScheduler *scheduler, DCPTask *task, uint32_t now) {
+    DCPSendTask *st = (DCPSendTask*)task;
+    DCPShard *shard = st->shard;
+
+    DCPCB *dcp = dcp_endpoint_find_conv(shard->endpoint, st->conv_id);
+    if (dcp == NULL) {
+        shard->send_dropped++;
+        shard->runtime->free_fn(st);
+        return;
+    }
+
+    DCPSendTask *head = (DCPSendTask*)dcp->send_backlog;
+    if (head != NULL) {
+        head->tail->next = st;
+        head->tail = st;
+        shard->send_deferred++;
+        return;
+    }
+    if (dcp_send_task_try(shard, dcp, st, now) == 0) return;
+
+    st->tail = st;
+    st->next_conv = shard->backlog;
+    dcp->send_backlog = st;
+    shard->send_deferred++;
+    if (shard->backlog == NULL) {
+        dcp_scheduler_add_flush(scheduler, &shard->backlog_task);
+    }
+    shard->backlog = st;
+}
+
+int dcp_runtime_send(DCPRuntime *rt, uint32_t conv_id, const char *buffer, int len) {
+    if (rt == NULL || buffer == NULL || len <= 0) return -1;
+
+    DCPSendTask *st = (DCPSendTask*)rt->alloc_fn(sizeof(DCPSendTask) + len);
+    if (st == NULL) return -2;
+
+    st->task.run = dcp_send_task_run;
+    st->shard = dcp_runtime_shard(rt, conv_id);
+    st->next = NULL;
+    st->conv_id = conv_id;
+    st->len = len;
+    memcpy(st->data, buffer, len);
+
+    return dcp_runtime_post(rt, conv_id, &st->task);
+}
+
+int dcp_shard_should_stop(const DCPShard *shard) {
+    return __atomic_load_n(&shard->stop, __ATOMIC_ACQUIRE);
+}
+
+static void dcp_shard_default_loop(DCPShard *shard, void *arg) {
+    (void)arg;
+
+    while (!dcp_shard_should_stop(shard)) {
+        if (dcp_loop_run_once(shard->loop, -1) < 0) break;
+    }
+}
+
+static void* dcp_shard_thread(void *arg) {
+    DCPShard *shard = (DCPShard*)arg;
+    DCPRuntime *rt = shard->runtime;
+
+    rt->loop(shard, rt->loop_arg);
+    return NULL;
+}
+
+int dcp_runtime_start(DCPRuntime *rt, dcp_shard_loop_fn loop, void *arg) {
+    if (rt == NULL) return -1;
+
+    rt->loop = loop ? loop : dcp_shard_default_loop;
+    rt->loop_arg = arg;
+
+    for (int i = 0; i < rt->shard_count; i++) {
+        DCPShard *shard = &rt->shards[i];
+        if (shard->started) continue;
+
+        if (rt->loop == dcp_shard_default_loop && shard->loop == NULL) {
+            shard->loop = dcp_loop_create(shard->scheduler);
+            if (shard->loop == NULL) {
+                dcp_runtime_stop(rt);
+                return -3;
+            }
+        }
+
+        __atomic_store_n(&shard->stop, 0, __ATOMIC_RELEASE);
+        if (pthread_create(&shard->thread, NULL, dcp_shard_thread, shard) != 0) {
+            dcp_runtime_stop(rt);
+            return -2;
+        }
+        shard->started = 1;
+    }
+    return 0;
+}
+
+void dcp_runtime_stop(DCPRuntime *rt) {
+    if (rt == NULL) return;
+
+    for (int i = 0; i < rt->shard_count; i++) {
+        __atomic_store_n(&rt->shards[i].stop, 1, __ATOMIC_RELEASE);
+        if (rt->shards[i].loop != NULL) {
+            dcp_loop_wakeup(rt->shards[i].loop);
+        }
+    }
+    for (int i = 0; i < rt->shard_count; i++) {
+        DCPShard *shard = &rt->shards[i];
+        if (shard->started) {
+            pthread_join(shard->thread, NULL);
+            shard->started = 0;
+        }
+        if (shard->loop != NULL) {
+            dcp_loop_release(shard->loop);
+            shard->loop = NULL;
+        }
+    }
+}
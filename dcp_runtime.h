@@ -0,0 +1,69 @@
+#ifndef __DCP_RUNTIME_H__
+#define __DCP_RUNTIME_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "dcp.h"
+#include "dcp_endpoint.h"
+#include "dcp_loop.h"
+
+#define DCP_RUNTIME_MAX_SHARDS   256
+
+struct DCPRuntime;
+struct DCPShard;
+struct DCPSendTask;
+
+typedef void (*dcp_shard_loop_fn)(struct DCPShard *shard, void *arg);
+
+typedef struct DCPShard {
+    struct DCPRuntime *runtime;
+    int index;
+
+    DCPScheduler *scheduler;
+    DCPEndpoint *endpoint;
+    DCPLoop *loop;
+
+    pthread_t thread;
+    int started;
+    int stop;
+
+    uint64_t posted;
+    uint64_t send_dropped;
+    uint64_t send_deferred;
+
+    struct DCPSendTask *backlog;
+    DCPTask backlog_task;
+} DCPShard;
+
+typedef struct DCPRuntime {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    int shard_count;
+    DCPShard *shards;
+
+    dcp_shard_loop_fn loop;
+    void *loop_arg;
+} DCPRuntime;
+
+DCPRuntime* dcp_runtime_create(int shard_count);
+
+void dcp_runtime_release(DCPRuntime *rt);
+
+int dcp_runtime_shard_index(const DCPRuntime *rt, uint32_t conv_id);
+
+DCPShard* dcp_runtime_shard(DCPRuntime *rt, uint32_t conv_id);
+
+int dcp_runtime_post(DCPRuntime *rt, uint32_t conv_id, DCPTask *task);
+
+int dcp_runtime_send(DCPRuntime *rt, uint32_t conv_id, const char *buffer, int len);
+
+int dcp_runtime_start(DCPRuntime *rt, dcp_shard_loop_fn loop, void *arg);
+
+void dcp_runtime_stop(DCPRuntime *rt);
+
+int dcp_shard_should_stop(const DCPShard *shard);
+
+uint64_t dcp_runtime_now_us(void);
+
+#endif
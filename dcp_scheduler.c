@@ -11,6 +11,8 @@ static void list_add_tail(DCPTimerNode *head, DCPTimerNode *node) {
 static void list_del(DCPTimerNode *node) {
     node->prev->next = node->next;
     node->next->prev = node->prev;
+    node->next = NULL;
+    node->prev = NULL;
 }
 
 static void list_init_head(DCPTimerNode *head) {
@@ -18,6 +20,18 @@ static void list_init_head(DCPTimerNode *head) {
     head->prev = head;
 }
 
+static void list_splice_init(DCPTimerNode *from, DCPTimerNode *to) {
+    if (from->next == from) {
+        list_init_head(to);
+        return;
+    }
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init_head(from);
+}
+
 
 DCPScheduler* dcp_scheduler_create(void) {
     dcp_malloc_fn malloc_fn = dcp_get_malloc();
@@ -28,99 +42,478 @@ DCPScheduler* dcp_scheduler_create(void) {
     memset(scheduler, 0, sizeof(DCPScheduler));
     scheduler->alloc_fn = malloc_fn;
     scheduler->free_fn = dcp_get_free();
+    scheduler->seg_pool = dcp_pool_create();
+    if (scheduler->seg_pool == NULL) {
+        scheduler->free_fn(scheduler);
+        return NULL;
+    }
     scheduler->last_tick_ms = 0;
-    scheduler->current_slot = 0;
+    scheduler->now_us = 0;
+    scheduler->current_tick = 0;
+    scheduler->inbox_head = &scheduler->inbox_stub;
+    scheduler->inbox_tail = &scheduler->inbox_stub;
 
-    for (int i = 0; i < DCP_TIMER_WHEEL_SIZE; i++) {
-        list_init_head(&scheduler->wheel[i]);
+    for (int i = 0; i < DCP_TIMER_ROOT_SIZE; i++) {
+        list_init_head(&scheduler->root[i]);
+    }
+    for (int l = 0; l < DCP_TIMER_LEVELS; l++) {
+        for (int i = 0; i < DCP_TIMER_LEVEL_SIZE; i++) {
+            list_init_head(&scheduler->levels[l][i]);
+        }
     }
     
     return scheduler;
 }
 
-void dcp_scheduler_release(DCPScheduler *scheduler) {
-    if (scheduler == NULL) return;
+static inline void dcp_root_mark(DCPScheduler *scheduler, uint32_t index) {
+    scheduler->root_bits[index >> 6] |= 1ULL << (index & 63);
+}
 
-    dcp_free_fn free_fn = scheduler->free_fn;
+static inline void dcp_root_clear(DCPScheduler *scheduler, uint32_t index) {
+    scheduler->root_bits[index >> 6] &= ~(1ULL << (index & 63));
+}
 
-    for (int i = 0; i < DCP_TIMER_WHEEL_SIZE; i++) {
-        DCPTimerNode *head = &scheduler->wheel[i];
-        DCPTimerNode *node = head->next;
-        while (node != head) {
-            DCPTimerNode *to_free = node;
-            node = node->next;
-            free_fn(to_free);
+static inline int dcp_root_test(const DCPScheduler *scheduler, uint32_t index) {
+    return (scheduler->root_bits[index >> 6] >> (index & 63)) & 1;
+}
+
+static int dcp_root_find(const DCPScheduler *scheduler, uint32_t from, uint32_t to) {
+    for (uint32_t w = from >> 6; (w << 6) < to; w++) {
+        uint64_t bits = scheduler->root_bits[w];
+        if (w == (from >> 6)) bits &= ~0ULL << (from & 63);
+        if (bits != 0) {
+            uint32_t index = (w << 6) + (uint32_t)__builtin_ctzll(bits);
+            return (index < to) ? (int)index : -1;
         }
     }
-    
-    free_fn(scheduler);
+    return -1;
+}
+
+static void dcp_scheduler_detach_all(DCPTimerNode *head) {
+    while (head->next != head) {
+        list_del(head->next);
+    }
+}
+
+static void dcp_inbox_push(DCPScheduler *scheduler, DCPTask *task) {
+    __atomic_store_n(&task->next, NULL, __ATOMIC_RELAXED);
+    DCPTask *prev = __atomic_exchange_n(&scheduler->inbox_head, task, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, task, __ATOMIC_RELEASE);
+}
+
+static DCPTask* dcp_inbox_pop(DCPScheduler *scheduler) {
+    DCPTask *stub = &scheduler->inbox_stub;
+    DCPTask *tail = scheduler->inbox_tail;
+    DCPTask *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == stub) {
+        if (next == NULL) return NULL;
+        scheduler->inbox_tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != NULL) {
+        scheduler->inbox_tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&scheduler->inbox_head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    dcp_inbox_push(scheduler, stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        scheduler->inbox_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static void dcp_inbox_drain(DCPScheduler *scheduler, uint32_t now) {
+    if (__atomic_load_n(&scheduler->inbox_pending, __ATOMIC_ACQUIRE) != 0) {
+        __atomic_store_n(&scheduler->inbox_pending, 0, __ATOMIC_RELEASE);
+    }
+
+    DCPTask *task;
+    while ((task = dcp_inbox_pop(scheduler)) != NULL) {
+        DCP_STAT_INC(scheduler->stats, tasks_run);
+        task->run(scheduler, task, now);
+    }
 }
 
-void dcp_scheduler_add(DCPScheduler *scheduler, struct DCPCB *dcp, 
-                       uint32_t timeout_ms, 
-                       void (*callback)(struct DCPCB*, uint32_t)) {
+void dcp_scheduler_post(DCPScheduler *scheduler, DCPTask *task) {
+    dcp_inbox_push(scheduler, task);
+    if (__atomic_fetch_add(&scheduler->inbox_pending, 1, __ATOMIC_ACQ_REL) == 0 &&
+        scheduler->wakeup != NULL) {
+        scheduler->wakeup(scheduler, scheduler->wakeup_arg);
+    }
+}
 
-    dcp_malloc_fn malloc_fn = scheduler->alloc_fn;
+void dcp_scheduler_set_wakeup(DCPScheduler *scheduler,
+                              void (*wakeup)(DCPScheduler*, void*), void *arg) {
+    scheduler->wakeup = wakeup;
+    scheduler->wakeup_arg = arg;
+}
 
-    DCPTimerNode *node = (DCPTimerNode*)malloc_fn(sizeof(DCPTimerNode));
-    if (node == NULL) return;
+void dcp_scheduler_add_flush(DCPScheduler *scheduler, DCPTask *task) {
+    task->next = scheduler->flush_tasks;
+    scheduler->flush_tasks = task;
+}
 
+void dcp_scheduler_remove_flush(DCPScheduler *scheduler, DCPTask *task) {
+    DCPTask **link = &scheduler->flush_tasks;
+    while (*link != NULL && *link != task) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) *link = task->next;
+}
+
+void dcp_scheduler_release(DCPScheduler *scheduler) {
+    if (scheduler == NULL) return;
+
+    dcp_inbox_drain(scheduler, scheduler->last_tick_ms);
+
+    for (int i = 0; i < DCP_TIMER_ROOT_SIZE; i++) {
+        dcp_scheduler_detach_all(&scheduler->root[i]);
+    }
+    for (int l = 0; l < DCP_TIMER_LEVELS; l++) {
+        for (int i = 0; i < DCP_TIMER_LEVEL_SIZE; i++) {
+            dcp_scheduler_detach_all(&scheduler->levels[l][i]);
+        }
+    }
+
+    dcp_scheduler_reclaim(scheduler);
+    dcp_pool_release(scheduler->seg_pool);
+    scheduler->free_fn(scheduler);
+}
+
+void dcp_timer_init(DCPTimerNode *node, struct DCPCB *dcp, 
+                    void (*callback)(struct DCPCB*, uint32_t)) {
+    node->prev = NULL;
+    node->next = NULL;
     node->dcp = dcp;
+    node->expires_tick = 0;
     node->callback = callback;
-    
-    uint32_t now = scheduler->last_tick_ms; 
-    node->expires_at_ms = now + timeout_ms;
-    
-    if (timeout_ms < DCP_TIMER_RESOLUTION) {
-        node->expires_at_ms = now + DCP_TIMER_RESOLUTION;
+}
+
+int dcp_timer_pending(const DCPTimerNode *node) {
+    return node->next != NULL;
+}
+
+static void dcp_scheduler_link(DCPScheduler *scheduler, DCPTimerNode *node) {
+    uint64_t expires = node->expires_tick;
+    uint64_t idx;
+    DCPTimerNode *head;
+
+    if (expires < scheduler->current_tick) {
+        expires = scheduler->current_tick;
+        node->expires_tick = expires;
     }
+    idx = expires - scheduler->current_tick;
 
-    uint32_t ticks_to_expire = (node->expires_at_ms / DCP_TIMER_RESOLUTION);
-    uint32_t slot = ticks_to_expire % DCP_TIMER_WHEEL_SIZE;
-    
-    list_add_tail(&scheduler->wheel[slot], node);
+    if (idx < DCP_TIMER_ROOT_SIZE) {
+        head = &scheduler->root[expires & (DCP_TIMER_ROOT_SIZE - 1)];
+        dcp_root_mark(scheduler, (uint32_t)(expires & (DCP_TIMER_ROOT_SIZE - 1)));
+    } else {
+        int level = 0;
+        while (level < DCP_TIMER_LEVELS - 1 &&
+               idx >= (1ULL << (DCP_TIMER_ROOT_BITS + (level + 1) * DCP_TIMER_LEVEL_BITS))) {
+            level++;
+        }
+        if (idx > DCP_TIMER_MAX_TICKS) {
+            expires = scheduler->current_tick + DCP_TIMER_MAX_TICKS;
+            node->expires_tick = expires;
+        }
+        uint32_t shift = DCP_TIMER_ROOT_BITS + level * DCP_TIMER_LEVEL_BITS;
+        uint32_t index = (uint32_t)(expires >> shift) & (DCP_TIMER_LEVEL_SIZE - 1);
+        head = &scheduler->levels[level][index];
+        scheduler->level_bits[level] |= 1ULL << index;
+    }
+
+    list_add_tail(head, node);
 }
 
+void dcp_scheduler_add_us(DCPScheduler *scheduler, DCPTimerNode *node, 
+                          uint64_t timeout_us) {
 
-void dcp_scheduler_run(DCPScheduler *scheduler, uint32_t current_time_ms) {
+    if (dcp_timer_pending(node)) {
+        list_del(node);
+        scheduler->timer_count--;
+    }
+
+    node->expires_tick = (scheduler->now_us + timeout_us + DCP_TIMER_TICK_US - 1) / DCP_TIMER_TICK_US;
     
-    uint32_t now = current_time_ms - (current_time_ms % DCP_TIMER_RESOLUTION);
+    dcp_scheduler_link(scheduler, node);
+    scheduler->timer_count++;
+    DCP_STAT_INC(scheduler->stats, timers_added);
+}
+
+void dcp_scheduler_add(DCPScheduler *scheduler, DCPTimerNode *node, 
+                       uint32_t timeout_ms) {
+    dcp_scheduler_add_us(scheduler, node, (uint64_t)timeout_ms * 1000);
+}
+
+void dcp_scheduler_cancel(DCPScheduler *scheduler, DCPTimerNode *node) {
+    if (dcp_timer_pending(node)) {
+        list_del(node);
+        scheduler->timer_count--;
+        DCP_STAT_INC(scheduler->stats, timers_cancelled);
+    }
+}
+
+void dcp_scheduler_reschedule(DCPScheduler *scheduler, DCPTimerNode *node, 
+                              uint32_t timeout_ms) {
+    dcp_scheduler_cancel(scheduler, node);
+    dcp_scheduler_add(scheduler, node, timeout_ms);
+}
+
+uint64_t dcp_scheduler_now_us(const DCPScheduler *scheduler) {
+    return scheduler->now_us;
+}
+
+static uint32_t dcp_scheduler_cascade(DCPScheduler *scheduler, int level) {
+    uint32_t shift = DCP_TIMER_ROOT_BITS + level * DCP_TIMER_LEVEL_BITS;
+    uint32_t index = (uint32_t)(scheduler->current_tick >> shift) & (DCP_TIMER_LEVEL_SIZE - 1);
+    DCPTimerNode pending;
+
+    list_splice_init(&scheduler->levels[level][index], &pending);
+    scheduler->level_bits[level] &= ~(1ULL << index);
+    while (pending.next != &pending) {
+        DCPTimerNode *node = pending.next;
+        list_del(node);
+        dcp_scheduler_link(scheduler, node);
+        DCP_STAT_INC(scheduler->stats, timers_cascaded);
+    }
+    return index;
+}
+
+static void dcp_scheduler_rebase(DCPScheduler *scheduler, uint64_t tick) {
+    uint64_t shift = tick - scheduler->current_tick;
+    DCPTimerNode pending;
+
+    list_init_head(&pending);
+    for (int i = 0; i < DCP_TIMER_ROOT_SIZE; i++) {
+        while (scheduler->root[i].next != &scheduler->root[i]) {
+            DCPTimerNode *node = scheduler->root[i].next;
+            list_del(node);
+            list_add_tail(&pending, node);
+        }
+    }
+    for (int l = 0; l < DCP_TIMER_LEVELS; l++) {
+        for (int i = 0; i < DCP_TIMER_LEVEL_SIZE; i++) {
+            while (scheduler->levels[l][i].next != &scheduler->levels[l][i]) {
+                DCPTimerNode *node = scheduler->levels[l][i].next;
+                list_del(node);
+                list_add_tail(&pending, node);
+            }
+        }
+    }
+    memset(scheduler->root_bits, 0, sizeof(scheduler->root_bits));
+    memset(scheduler->level_bits, 0, sizeof(scheduler->level_bits));
+
+    scheduler->current_tick = tick;
+    while (pending.next != &pending) {
+        DCPTimerNode *node = pending.next;
+        list_del(node);
+        node->expires_tick += shift;
+        dcp_scheduler_link(scheduler, node);
+    }
+}
+
+static void dcp_scheduler_flush(DCPScheduler *scheduler) {
+    for (DCPTask *task = scheduler->flush_tasks; task != NULL; task = task->next) {
+        task->run(scheduler, task, scheduler->last_tick_ms);
+    }
+}
+
+void dcp_scheduler_run_us(DCPScheduler *scheduler, uint64_t current_time_us) {
     
-    if (now <= scheduler->last_tick_ms) {
+    uint64_t target_tick = current_time_us / DCP_TIMER_TICK_US;
+    DCPTimerNode pending;
+
+    if (!scheduler->started) {
+        scheduler->started = 1;
+        if (scheduler->current_tick < target_tick) {
+            dcp_scheduler_rebase(scheduler, target_tick);
+        }
+        scheduler->now_us = current_time_us;
+        scheduler->last_tick_ms = (uint32_t)(current_time_us / 1000);
+    }
+
+    if (current_time_us < scheduler->now_us) {
+        dcp_inbox_drain(scheduler, scheduler->last_tick_ms);
+        dcp_scheduler_flush(scheduler);
         return;
     }
+    DCP_STAT_INC(scheduler->stats, runs);
+
+    if (scheduler->timer_count == 0 && scheduler->current_tick <= target_tick) {
+        scheduler->current_tick = target_tick + 1;
+    }
+
+    while (scheduler->current_tick <= target_tick) {
+        uint64_t tick = scheduler->current_tick;
+        uint32_t index = (uint32_t)(tick & (DCP_TIMER_ROOT_SIZE - 1));
 
-    uint32_t ticks_to_process = (now - scheduler->last_tick_ms) / DCP_TIMER_RESOLUTION;
+        if (index != 0 && !dcp_root_test(scheduler, index)) {
+            int next = dcp_root_find(scheduler, index, DCP_TIMER_ROOT_SIZE);
+            uint64_t skip = tick + ((next >= 0) ? (uint32_t)next : DCP_TIMER_ROOT_SIZE) - index;
+            scheduler->current_tick = (skip > target_tick) ? target_tick + 1 : skip;
+            continue;
+        }
+
+        if (index == 0) {
+            for (int level = 0; level < DCP_TIMER_LEVELS; level++) {
+                if (dcp_scheduler_cascade(scheduler, level) != 0) break;
+            }
+        }
+
+        uint64_t tick_us = tick * DCP_TIMER_TICK_US;
 
-    if (ticks_to_process > DCP_TIMER_WHEEL_SIZE) {
-        ticks_to_process = DCP_TIMER_WHEEL_SIZE;
+        scheduler->now_us = (target_tick - tick > DCP_TIMER_ROOT_SIZE) ? current_time_us : tick_us;
+        scheduler->last_tick_ms = (uint32_t)(scheduler->now_us / 1000);
+        scheduler->current_tick = tick + 1;
+
+        list_splice_init(&scheduler->root[index], &pending);
+        dcp_root_clear(scheduler, index);
+        uint32_t fired = 0;
+        while (pending.next != &pending) {
+            DCPTimerNode *current = pending.next;
+            list_del(current);
+            scheduler->timer_count--;
+            fired++;
+
+            if (current->callback) {
+                current->callback(current->dcp, scheduler->last_tick_ms);
+            }
+        }
+
+#ifndef DCP_DISABLE_STATS
+        DCPSchedulerStats *stats = &scheduler->stats;
+        stats->ticks++;
+        stats->timers_fired += fired;
+        stats->callbacks_hist[dcp_stats_bucket(fired)]++;
+        if (fired > stats->max_callbacks_per_tick) stats->max_callbacks_per_tick = fired;
+        if (fired > 0) {
+            stats->latency_hist_us[dcp_stats_bucket(current_time_us - tick_us)]++;
+        }
+#endif
+        if (scheduler->trace != NULL && fired > 0) {
+            dcp_trace_record(scheduler->trace, DCP_TRACE_TIMER_TICK, tick_us, 0, fired,
+                             (uint32_t)(current_time_us - tick_us), tick, 0);
+        }
     }
 
-    dcp_free_fn free_fn = scheduler->free_fn;
+    scheduler->now_us = current_time_us;
+    scheduler->last_tick_ms = (uint32_t)(current_time_us / 1000);
+
+    dcp_inbox_drain(scheduler, scheduler->last_tick_ms);
+    dcp_scheduler_flush(scheduler);
+}
+
+uint64_t dcp_scheduler_next_expiry_us(DCPScheduler *scheduler) {
+    if (scheduler->timer_count == 0) return DCP_TIMER_NONE;
+
+    uint64_t cur = scheduler->current_tick;
+    uint64_t best = DCP_TIMER_NONE;
+    uint32_t start = (uint32_t)(cur & (DCP_TIMER_ROOT_SIZE - 1));
+
+    for (int pass = 0; pass < 2 && best == DCP_TIMER_NONE; pass++) {
+        uint32_t from = pass ? 0 : start;
+        uint32_t to = pass ? start : DCP_TIMER_ROOT_SIZE;
+        int index;
+        while ((index = dcp_root_find(scheduler, from, to)) >= 0) {
+            if (scheduler->root[index].next != &scheduler->root[index]) {
+                best = cur + (((uint32_t)index - start) & (DCP_TIMER_ROOT_SIZE - 1));
+                break;
+            }
+            dcp_root_clear(scheduler, (uint32_t)index);
+            from = (uint32_t)index + 1;
+        }
+    }
 
-    for (uint32_t i = 0; i < ticks_to_process; i++) {
-        
-        scheduler->current_slot = (scheduler->current_slot + 1) % DCP_TIMER_WHEEL_SIZE;
-        uint32_t processing_time = scheduler->last_tick_ms + (i + 1) * DCP_TIMER_RESOLUTION;
-        
-        DCPTimerNode *head = &scheduler->wheel[scheduler->current_slot];
-        DCPTimerNode *node = head->next;
+    for (int level = 0; level < DCP_TIMER_LEVELS; level++) {
+        uint32_t shift = DCP_TIMER_ROOT_BITS + level * DCP_TIMER_LEVEL_BITS;
+        uint32_t pos = (uint32_t)(cur >> shift) & (DCP_TIMER_LEVEL_SIZE - 1);
+        uint32_t first = ((cur & ((1ULL << shift) - 1)) == 0) ? 0 : 1;
+        uint32_t rot = (pos + first) & (DCP_TIMER_LEVEL_SIZE - 1);
 
-        while (node != head) {
-            DCPTimerNode *current = node;
-            node = node->next; 
+        while (scheduler->level_bits[level] != 0) {
+            uint64_t bits = scheduler->level_bits[level];
+            uint64_t r = rot ? ((bits >> rot) | (bits << (DCP_TIMER_LEVEL_SIZE - rot))) : bits;
+            uint32_t dist = (uint32_t)__builtin_ctzll(r);
+            uint32_t index = (rot + dist) & (DCP_TIMER_LEVEL_SIZE - 1);
 
-            if (processing_time >= current->expires_at_ms) {
-                list_del(current);
-                
-                if (current->callback) {
-                    current->callback(current->dcp, processing_time);
-                }
-                
-                free_fn(current);
+            if (scheduler->levels[level][index].next == &scheduler->levels[level][index]) {
+                scheduler->level_bits[level] &= ~(1ULL << index);
+                continue;
             }
+
+            uint64_t tick = ((cur >> shift) + first + dist) << shift;
+            if (tick < best) best = tick;
+            break;
         }
     }
 
-    scheduler->last_tick_ms = now;
+    return (best == DCP_TIMER_NONE) ? DCP_TIMER_NONE : best * DCP_TIMER_TICK_US;
+}
+
+int dcp_scheduler_next_timeout(DCPScheduler *scheduler, uint64_t now_us) {
+    if (__atomic_load_n(&scheduler->inbox_pending, __ATOMIC_ACQUIRE) != 0) return 0;
+
+    uint64_t expiry = dcp_scheduler_next_expiry_us(scheduler);
+    if (expiry == DCP_TIMER_NONE) return -1;
+    if (expiry <= now_us) return 0;
+
+    uint64_t ms = (expiry - now_us + 999) / 1000;
+    return (ms > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)ms;
+}
+
+void dcp_scheduler_run(DCPScheduler *scheduler, uint32_t current_time_ms) {
+    dcp_scheduler_run_us(scheduler, (uint64_t)current_time_ms * 1000);
+}
+
+void dcp_scheduler_get_stats(const DCPScheduler *scheduler, DCPSchedulerStats *stats) {
+    if (scheduler == NULL || stats == NULL) return;
+    *stats = scheduler->stats;
+    stats->timers_pending = scheduler->timer_count;
+}
+
+void dcp_scheduler_set_trace(DCPScheduler *scheduler, DCPTrace *trace) {
+    if (scheduler == NULL) return;
+    scheduler->trace = trace;
+}
+
+void dcp_scheduler_add_hold(DCPScheduler *scheduler, DCPRetireHold *hold) {
+    if (scheduler == NULL || hold == NULL) return;
+    hold->oldest = UINT64_MAX;
+    hold->next = scheduler->holds;
+    scheduler->holds = hold;
+}
+
+void dcp_scheduler_remove_hold(DCPScheduler *scheduler, DCPRetireHold *hold) {
+    if (scheduler == NULL || hold == NULL) return;
+
+    DCPRetireHold **link = &scheduler->holds;
+    while (*link != NULL && *link != hold) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) *link = hold->next;
+    dcp_scheduler_reclaim(scheduler);
+}
+
+void dcp_scheduler_reclaim(DCPScheduler *scheduler) {
+    uint64_t seq = UINT64_MAX;
+    for (DCPRetireHold *hold = scheduler->holds; hold != NULL; hold = hold->next) {
+        if (hold->oldest < seq) seq = hold->oldest;
+    }
+
+    DCPRetired *node = scheduler->retired;
+    while (node != NULL && node->seq <= seq) {
+        DCPRetired *next = node->next;
+        dcp_pool_free(scheduler->seg_pool, node);
+        scheduler->retired_count--;
+        node = next;
+    }
+    scheduler->retired = node;
+    if (node == NULL) scheduler->retired_tail = NULL;
 }
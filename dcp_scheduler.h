@@ -3,9 +3,27 @@
 
 #include <stdint.h>
 #include "dcp_allocator.h"
+#include "dcp_trace.h"
 
-#define DCP_TIMER_WHEEL_SIZE 1024
-#define DCP_TIMER_RESOLUTION 10
+#define DCP_TIMER_TICK_US        32
+#define DCP_TIMER_ROOT_BITS      8
+#define DCP_TIMER_LEVEL_BITS     6
+#define DCP_TIMER_LEVELS         4
+#define DCP_TIMER_ROOT_SIZE      (1 << DCP_TIMER_ROOT_BITS)
+#define DCP_TIMER_LEVEL_SIZE     (1 << DCP_TIMER_LEVEL_BITS)
+#define DCP_TIMER_MAX_TICKS      ((1ULL << (DCP_TIMER_ROOT_BITS + DCP_TIMER_LEVELS * DCP_TIMER_LEVEL_BITS)) - 1)
+
+#define DCP_TIMER_ROOT_WORDS     (DCP_TIMER_ROOT_SIZE / 64)
+#define DCP_TIMER_NONE           UINT64_MAX
+
+#define DCP_STATS_HIST_BUCKETS   20
+
+#ifndef DCP_DISABLE_STATS
+#define DCP_STAT_ADD(stats, field, n)  ((stats).field += (n))
+#else
+#define DCP_STAT_ADD(stats, field, n)  ((void)0)
+#endif
+#define DCP_STAT_INC(stats, field)     DCP_STAT_ADD(stats, field, 1)
 
 struct DCPCB;
 
@@ -14,20 +32,77 @@ typedef struct DCPTimerNode {
     struct DCPTimerNode *next;
     
     struct DCPCB *dcp;
-    uint32_t expires_at_ms;
+    uint64_t expires_tick;
     
     void (*callback)(struct DCPCB *dcp, uint32_t now);
     
 } DCPTimerNode;
 
+typedef struct DCPSchedulerStats {
+    uint32_t timers_pending;
+    uint64_t timers_added;
+    uint64_t timers_cancelled;
+    uint64_t timers_fired;
+    uint64_t timers_cascaded;
+    uint64_t tasks_run;
+    uint64_t runs;
+    uint64_t ticks;
+    uint32_t max_callbacks_per_tick;
+    uint64_t callbacks_hist[DCP_STATS_HIST_BUCKETS];
+    uint64_t latency_hist_us[DCP_STATS_HIST_BUCKETS];
+} DCPSchedulerStats;
+
+struct DCPScheduler;
+
+typedef struct DCPTask {
+    struct DCPTask *next;
+    void (*run)(struct DCPScheduler *scheduler, struct DCPTask *task, uint32_t now);
+} DCPTask;
+
+typedef struct DCPRetired {
+    struct DCPRetired *next;
+    uint64_t seq;
+} DCPRetired;
+
+typedef struct DCPRetireHold {
+    struct DCPRetireHold *next;
+    uint64_t oldest;
+} DCPRetireHold;
+
 typedef struct DCPScheduler {
     dcp_malloc_fn alloc_fn;
     dcp_free_fn free_fn;
 
+    DCPPool *seg_pool;
+
     uint32_t last_tick_ms;
-    uint32_t current_slot;
+    uint64_t now_us;
+    uint64_t current_tick;
+    uint32_t timer_count;
+    uint32_t started;
+
+    DCPTask *inbox_head;
+    DCPTask *inbox_tail;
+    DCPTask inbox_stub;
+    uint32_t inbox_pending;
+    void (*wakeup)(struct DCPScheduler *scheduler, void *arg);
+    void *wakeup_arg;
+    DCPTask *flush_tasks;
+
+    DCPRetireHold *holds;
+    uint64_t retire_seq;
+    DCPRetired *retired;
+    DCPRetired *retired_tail;
+    uint32_t retired_count;
     
-    DCPTimerNode wheel[DCP_TIMER_WHEEL_SIZE];
+    DCPTimerNode root[DCP_TIMER_ROOT_SIZE];
+    DCPTimerNode levels[DCP_TIMER_LEVELS][DCP_TIMER_LEVEL_SIZE];
+
+    uint64_t root_bits[DCP_TIMER_ROOT_WORDS];
+    uint64_t level_bits[DCP_TIMER_LEVELS];
+
+    DCPSchedulerStats stats;
+    DCPTrace *trace;
     
 } DCPScheduler;
 
@@ -37,8 +112,69 @@ void dcp_scheduler_release(DCPScheduler *scheduler);
 
 void dcp_scheduler_run(DCPScheduler *scheduler, uint32_t current_time_ms);
 
-void dcp_scheduler_add(DCPScheduler *scheduler, struct DCPCB *dcp, 
-                       uint32_t timeout_ms, 
-                       void (*callback)(struct DCPCB*, uint32_t));
+void dcp_scheduler_run_us(DCPScheduler *scheduler, uint64_t current_time_us);
+
+uint64_t dcp_scheduler_now_us(const DCPScheduler *scheduler);
+
+uint64_t dcp_scheduler_next_expiry_us(DCPScheduler *scheduler);
+
+int dcp_scheduler_next_timeout(DCPScheduler *scheduler, uint64_t now_us);
+
+void dcp_timer_init(DCPTimerNode *node, struct DCPCB *dcp, 
+                    void (*callback)(struct DCPCB*, uint32_t));
+
+int dcp_timer_pending(const DCPTimerNode *node);
+
+void dcp_scheduler_add(DCPScheduler *scheduler, DCPTimerNode *node, 
+                       uint32_t timeout_ms);
+
+void dcp_scheduler_add_us(DCPScheduler *scheduler, DCPTimerNode *node, 
+                          uint64_t timeout_us);
+
+void dcp_scheduler_cancel(DCPScheduler *scheduler, DCPTimerNode *node);
+
+void dcp_scheduler_reschedule(DCPScheduler *scheduler, DCPTimerNode *node, 
+                              uint32_t timeout_ms);
+
+void dcp_scheduler_post(DCPScheduler *scheduler, DCPTask *task);
+
+void dcp_scheduler_set_wakeup(DCPScheduler *scheduler,
+                              void (*wakeup)(DCPScheduler*, void*), void *arg);
+
+void dcp_scheduler_add_flush(DCPScheduler *scheduler, DCPTask *task);
+
+void dcp_scheduler_remove_flush(DCPScheduler *scheduler, DCPTask *task);
+
+void dcp_scheduler_get_stats(const DCPScheduler *scheduler, DCPSchedulerStats *stats);
+
+void dcp_scheduler_set_trace(DCPScheduler *scheduler, DCPTrace *trace);
+
+static inline uint32_t dcp_stats_bucket(uint64_t v) {
+    uint32_t b = (v == 0) ? 0 : 64 - (uint32_t)__builtin_clzll(v);
+    return (b < DCP_STATS_HIST_BUCKETS) ? b : DCP_STATS_HIST_BUCKETS - 1;
+}
+
+void dcp_scheduler_add_hold(DCPScheduler *scheduler, DCPRetireHold *hold);
+
+void dcp_scheduler_remove_hold(DCPScheduler *scheduler, DCPRetireHold *hold);
+
+void dcp_scheduler_reclaim(DCPScheduler *scheduler);
+
+static inline void dcp_scheduler_retire(DCPScheduler *scheduler, void *ptr) {
+    if (scheduler->holds != NULL) {
+        DCPRetired *node = (DCPRetired*)ptr;
+        node->next = NULL;
+        node->seq = scheduler->retire_seq;
+        if (scheduler->retired_tail) {
+            scheduler->retired_tail->next = node;
+        } else {
+            scheduler->retired = node;
+        }
+        scheduler->retired_tail = node;
+        scheduler->retired_count++;
+    } else {
+        dcp_pool_free(scheduler->seg_pool, ptr);
+    }
+}
 
 #endif
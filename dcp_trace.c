@@ -0,0 +1,125 @@
+#include "dcp_trace.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DCP_TRACE_MIN_CAPACITY   64
+#define DCP_TRACE_DUMP_CHUNK     256
+
+DCPTrace* dcp_trace_create(uint32_t capacity) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    uint32_t cap = DCP_TRACE_MIN_CAPACITY;
+    while (cap < capacity) {
+        if (cap >= (1u << 31)) return NULL;
+        cap <<= 1;
+    }
+
+    DCPTrace *trace = (DCPTrace*)malloc_fn(sizeof(DCPTrace));
+    if (trace == NULL) return NULL;
+
+    memset(trace, 0, sizeof(DCPTrace));
+    trace->alloc_fn = malloc_fn;
+    trace->free_fn = dcp_get_free();
+    trace->mask = cap - 1;
+    trace->events = DCP_TRACE_ALL;
+
+    trace->ring = (DCPTraceEvent*)malloc_fn((size_t)cap * sizeof(DCPTraceEvent));
+    if (trace->ring == NULL) {
+        trace->free_fn(trace);
+        return NULL;
+    }
+    memset(trace->ring, 0, (size_t)cap * sizeof(DCPTraceEvent));
+
+    return trace;
+}
+
+void dcp_trace_release(DCPTrace *trace) {
+    if (trace == NULL) return;
+    trace->free_fn(trace->ring);
+    trace->free_fn(trace);
+}
+
+void dcp_trace_set_events(DCPTrace *trace, uint32_t events) {
+    if (trace == NULL) return;
+    trace->events = events & DCP_TRACE_ALL;
+}
+
+uint32_t dcp_trace_read(const DCPTrace *trace, uint64_t *cursor,
+                        DCPTraceEvent *events, uint32_t max) {
+    if (trace == NULL || cursor == NULL || events == NULL) return 0;
+
+    uint64_t cap = (uint64_t)trace->mask + 1;
+
+    for (;;) {
+        uint64_t end = __atomic_load_n(&trace->committed, __ATOMIC_ACQUIRE);
+        uint64_t pos = *cursor;
+
+        if (pos > end) pos = end;
+        if (end - pos > cap) pos = end - cap;
+
+        uint32_t n = 0;
+        while (n < max && pos + n < end) {
+            events[n] = trace->ring[(pos + n) & trace->mask];
+            n++;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t reserved = __atomic_load_n(&trace->reserved, __ATOMIC_RELAXED);
+
+        if (reserved > cap && pos < reserved - cap) {
+            uint64_t skip = reserved - cap - pos;
+            if (skip >= n) {
+                *cursor = reserved - cap;
+                if (n == 0) return 0;
+                continue;
+            }
+            memmove(events, events + skip, (size_t)(n - skip) * sizeof(DCPTraceEvent));
+            n -= (uint32_t)skip;
+            pos += skip;
+        }
+
+        *cursor = pos + n;
+        return n;
+    }
+}
+
+static int dcp_trace_write_all(int fd, const void *data, size_t len) {
+    const char *p = (const char*)data;
+    while (len > 0) {
+        ssize_t ret = write(fd, p, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += ret;
+        len -= (size_t)ret;
+    }
+    return 0;
+}
+
+int dcp_trace_write_header(int fd) {
+    DCPTraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DCP_TRACE_FILE_MAGIC;
+    header.version = DCP_TRACE_FILE_VERSION;
+    header.event_size = sizeof(DCPTraceEvent);
+    return dcp_trace_write_all(fd, &header, sizeof(header));
+}
+
+int dcp_trace_dump(const DCPTrace *trace, uint64_t *cursor, int fd) {
+    DCPTraceEvent chunk[DCP_TRACE_DUMP_CHUNK];
+    int total = 0;
+
+    if (trace == NULL || cursor == NULL) return -1;
+
+    for (;;) {
+        uint32_t n = dcp_trace_read(trace, cursor, chunk, DCP_TRACE_DUMP_CHUNK);
+        if (n == 0) break;
+        if (dcp_trace_write_all(fd, chunk, (size_t)n * sizeof(DCPTraceEvent)) < 0) {
+            return -1;
+        }
+        total += (int)n;
+    }
+    return total;
+}
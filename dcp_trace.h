@@ -0,0 +1,102 @@
+#ifndef __DCP_TRACE_H__
+#define __DCP_TRACE_H__
+
+#include <stdint.h>
+#include "dcp_allocator.h"
+
+#define DCP_TRACE_PKT_SENT       0
+#define DCP_TRACE_PKT_RETRANS    1
+#define DCP_TRACE_PKT_RECV       2
+#define DCP_TRACE_PKT_ACKED      3
+#define DCP_TRACE_PKT_SACKED     4
+#define DCP_TRACE_PKT_LOST       5
+#define DCP_TRACE_RTO            6
+#define DCP_TRACE_TLP            7
+#define DCP_TRACE_PACING         8
+#define DCP_TRACE_CC_STATE       9
+#define DCP_TRACE_METRICS        10
+#define DCP_TRACE_TIMER_TICK     11
+#define DCP_TRACE_EVENT_TYPES    12
+#define DCP_TRACE_ALL            ((1u << DCP_TRACE_EVENT_TYPES) - 1)
+
+#define DCP_TRACE_REASON_FASTACK 0
+#define DCP_TRACE_REASON_RACK    1
+#define DCP_TRACE_REASON_RTO     2
+#define DCP_TRACE_REASON_TLP     3
+
+#define DCP_TRACE_RECV_OK        0
+#define DCP_TRACE_RECV_DUP       1
+#define DCP_TRACE_RECV_WINDOW    2
+
+#define DCP_TRACE_FILE_MAGIC     0x31435254504344ULL
+#define DCP_TRACE_FILE_VERSION   1
+
+typedef struct DCPTraceEvent {
+    uint64_t time_us;
+    uint32_t conv_id;
+    uint16_t type;
+    uint16_t flags;
+    uint32_t a;
+    uint32_t b;
+    uint64_t c;
+} DCPTraceEvent;
+
+typedef struct DCPTraceFileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t event_size;
+} DCPTraceFileHeader;
+
+typedef struct DCPTrace {
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    uint32_t mask;
+    uint32_t events;
+
+    uint64_t reserved;
+    uint64_t committed;
+
+    DCPTraceEvent *ring;
+} DCPTrace;
+
+DCPTrace* dcp_trace_create(uint32_t capacity);
+
+void dcp_trace_release(DCPTrace *trace);
+
+void dcp_trace_set_events(DCPTrace *trace, uint32_t events);
+
+uint32_t dcp_trace_read(const DCPTrace *trace, uint64_t *cursor,
+                        DCPTraceEvent *events, uint32_t max);
+
+int dcp_trace_write_header(int fd);
+
+int dcp_trace_dump(const DCPTrace *trace, uint64_t *cursor, int fd);
+
+static inline void dcp_trace_record(DCPTrace *trace, uint32_t type, uint64_t time_us,
+                                    uint32_t conv_id, uint32_t a, uint32_t b,
+                                    uint64_t c, uint32_t flags) {
+#ifndef DCP_DISABLE_TRACE
+    if (!(trace->events & (1u << type))) return;
+
+    uint64_t seq = trace->reserved;
+    __atomic_store_n(&trace->reserved, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    DCPTraceEvent *ev = &trace->ring[seq & trace->mask];
+    ev->time_us = time_us;
+    ev->conv_id = conv_id;
+    ev->type = (uint16_t)type;
+    ev->flags = (uint16_t)flags;
+    ev->a = a;
+    ev->b = b;
+    ev->c = c;
+
+    __atomic_store_n(&trace->committed, seq + 1, __ATOMIC_RELEASE);
+#else
+    (void)trace; (void)type; (void)time_us; (void)conv_id;
+    (void)a; (void)b; (void)c; (void)flags;
+#endif
+}
+
+#endif
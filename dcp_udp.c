@@ -0,0 +1,343 @@
+#define _GNU_SOURCE
+#include "dcp_udp.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+typedef struct DCPUdpTxMeta {
+    uint32_t seg_size;
+    uint32_t segs;
+    int closed;
+} DCPUdpTxMeta;
+
+struct DCPUdp {
+    DCPTask flush_task;
+    int fd;
+    int features;
+    DCPEndpoint *endpoint;
+    DCPScheduler *scheduler;
+
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    DCPUdpStats stats;
+
+    char *rx_buf;
+    uint32_t rx_buf_size;
+    struct mmsghdr rx_msgs[DCP_UDP_RX_BATCH];
+    struct iovec rx_iov[DCP_UDP_RX_BATCH];
+    struct sockaddr_in6 rx_addr[DCP_UDP_RX_BATCH];
+    char rx_cmsg[DCP_UDP_RX_BATCH][CMSG_SPACE(sizeof(int))];
+
+    char *tx_buf;
+    uint32_t tx_used;
+    int tx_count;
+    struct mmsghdr tx_msgs[DCP_UDP_TX_BATCH];
+    struct iovec tx_iov[DCP_UDP_TX_BATCH];
+    struct sockaddr_in6 tx_addr[DCP_UDP_TX_BATCH];
+    DCPUdpTxMeta tx_meta[DCP_UDP_TX_BATCH];
+    char tx_cmsg[DCP_UDP_TX_BATCH][CMSG_SPACE(sizeof(uint16_t))];
+};
+
+static void dcp_udp_send_split(DCPUdp *udp, struct msghdr *msg, uint32_t seg_size) {
+    char *base = (char*)msg->msg_iov[0].iov_base;
+    size_t len = msg->msg_iov[0].iov_len;
+
+    for (size_t off = 0; off < len; off += seg_size) {
+        size_t n = (len - off < seg_size) ? len - off : seg_size;
+        udp->stats.tx_syscalls++;
+        if (sendto(udp->fd, base + off, n, 0, (struct sockaddr*)msg->msg_name, msg->msg_namelen) < 0) {
+            udp->stats.tx_errors++;
+        } else {
+            udp->stats.tx_datagrams++;
+        }
+    }
+}
+
+int dcp_udp_flush(DCPUdp *udp) {
+    if (udp == NULL || udp->tx_count == 0) return 0;
+
+    for (int i = 0; i < udp->tx_count; i++) {
+        struct msghdr *msg = &udp->tx_msgs[i].msg_hdr;
+        DCPUdpTxMeta *meta = &udp->tx_meta[i];
+
+        if (meta->segs > 1) {
+            struct cmsghdr *cm;
+            msg->msg_control = udp->tx_cmsg[i];
+            msg->msg_controllen = sizeof(udp->tx_cmsg[i]);
+            cm = CMSG_FIRSTHDR(msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t*)CMSG_DATA(cm) = (uint16_t)meta->seg_size;
+        } else {
+            msg->msg_control = NULL;
+            msg->msg_controllen = 0;
+        }
+    }
+
+    int off = 0;
+    while (off < udp->tx_count) {
+        int sent = sendmmsg(udp->fd, &udp->tx_msgs[off], udp->tx_count - off, 0);
+        udp->stats.tx_syscalls++;
+        if (sent > 0) {
+            for (int i = off; i < off + sent; i++) {
+                udp->stats.tx_datagrams += udp->tx_meta[i].segs;
+            }
+            off += sent;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+            for (int i = off; i < udp->tx_count; i++) {
+                udp->stats.tx_dropped += udp->tx_meta[i].segs;
+            }
+            break;
+        }
+
+        if (udp->tx_meta[off].segs > 1 && (errno == EIO || errno == EINVAL)) {
+            udp->features &= ~DCP_UDP_GSO;
+            dcp_udp_send_split(udp, &udp->tx_msgs[off].msg_hdr, udp->tx_meta[off].seg_size);
+        } else {
+            udp->stats.tx_errors += udp->tx_meta[off].segs;
+        }
+        off++;
+    }
+
+    int count = udp->tx_count;
+    udp->tx_count = 0;
+    udp->tx_used = 0;
+    return count;
+}
+
+static int dcp_udp_queue(DCPUdp *udp, const DCPCB *dcp, const char *data, uint32_t len) {
+    if (len > DCP_UDP_TX_BYTES) return -1;
+
+    if (udp->tx_count == DCP_UDP_TX_BATCH || udp->tx_used + len > DCP_UDP_TX_BYTES) {
+        dcp_udp_flush(udp);
+    }
+
+    char *dst = udp->tx_buf + udp->tx_used;
+    memcpy(dst, data, len);
+    udp->tx_used += len;
+    udp->stats.tx_segments++;
+
+    if (udp->tx_count > 0 && (udp->features & DCP_UDP_GSO)) {
+        int last = udp->tx_count - 1;
+        DCPUdpTxMeta *meta = &udp->tx_meta[last];
+        struct iovec *iov = &udp->tx_iov[last];
+
+        if (!meta->closed && len <= meta->seg_size &&
+            meta->segs < DCP_UDP_GSO_MAX_SEGS &&
+            iov->iov_len + len <= DCP_UDP_GSO_MAX_BYTES &&
+            (char*)iov->iov_base + iov->iov_len == dst &&
+            udp->tx_msgs[last].msg_hdr.msg_namelen == dcp->peer_addr.len &&
+            memcmp(&udp->tx_addr[last], dcp->peer_addr.data, dcp->peer_addr.len) == 0) {
+            iov->iov_len += len;
+            meta->segs++;
+            if (len < meta->seg_size) meta->closed = 1;
+            return 0;
+        }
+    }
+
+    int i = udp->tx_count++;
+    struct msghdr *msg = &udp->tx_msgs[i].msg_hdr;
+
+    memcpy(&udp->tx_addr[i], dcp->peer_addr.data, dcp->peer_addr.len);
+    udp->tx_iov[i].iov_base = dst;
+    udp->tx_iov[i].iov_len = len;
+    memset(msg, 0, sizeof(struct msghdr));
+    msg->msg_name = &udp->tx_addr[i];
+    msg->msg_namelen = dcp->peer_addr.len;
+    msg->msg_iov = &udp->tx_iov[i];
+    msg->msg_iovlen = 1;
+
+    udp->tx_meta[i].seg_size = len;
+    udp->tx_meta[i].segs = 1;
+    udp->tx_meta[i].closed = 0;
+    return 0;
+}
+
+static void dcp_udp_flush_task_run(DCPScheduler *scheduler, DCPTask *task, uint32_t now) {
+    (void)scheduler;
+    (void)now;
+    dcp_udp_flush((DCPUdp*)task);
+}
+
+static int dcp_udp_output(const DCPPacket *packets, int count, DCPCB *dcp, void *user) {
+    DCPUdp *udp = (DCPUdp*)dcp->transport;
+    (void)user;
+
+    if (udp == NULL || dcp->peer_addr.len == 0) return -1;
+
+    for (int i = 0; i < count; i++) {
+        if (dcp_udp_queue(udp, dcp, packets[i].data, (uint32_t)packets[i].len) < 0) {
+            udp->stats.tx_errors++;
+        }
+    }
+    return 0;
+}
+
+DCPUdp* dcp_udp_open(DCPEndpoint *ep, const struct sockaddr *bind_addr,
+                     socklen_t addrlen, int features) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    if (ep == NULL || bind_addr == NULL) return NULL;
+
+    DCPUdp *udp = (DCPUdp*)malloc_fn(sizeof(DCPUdp));
+    if (udp == NULL) return NULL;
+
+    memset(udp, 0, sizeof(DCPUdp));
+    udp->alloc_fn = malloc_fn;
+    udp->free_fn = dcp_get_free();
+    udp->endpoint = ep;
+    udp->flush_task.run = dcp_udp_flush_task_run;
+
+    udp->fd = socket(bind_addr->sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (udp->fd < 0 || bind(udp->fd, bind_addr, addrlen) < 0) {
+        if (udp->fd >= 0) close(udp->fd);
+        udp->free_fn(udp);
+        return NULL;
+    }
+
+    if (features & DCP_UDP_GSO) {
+        int zero = 0;
+        if (setsockopt(udp->fd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0) {
+            udp->features |= DCP_UDP_GSO;
+        }
+    }
+    if (features & DCP_UDP_GRO) {
+        int one = 1;
+        if (setsockopt(udp->fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0) {
+            udp->features |= DCP_UDP_GRO;
+        }
+    }
+
+    udp->rx_buf_size = (udp->features & DCP_UDP_GRO) ? DCP_UDP_RX_GRO_BUF : DCP_UDP_RX_BUF;
+    udp->rx_buf = (char*)malloc_fn((size_t)udp->rx_buf_size * DCP_UDP_RX_BATCH);
+    udp->tx_buf = (char*)malloc_fn(DCP_UDP_TX_BYTES);
+    if (udp->rx_buf == NULL || udp->tx_buf == NULL) {
+        dcp_udp_close(udp);
+        return NULL;
+    }
+
+    for (int i = 0; i < DCP_UDP_RX_BATCH; i++) {
+        udp->rx_iov[i].iov_base = udp->rx_buf + (size_t)i * udp->rx_buf_size;
+        udp->rx_iov[i].iov_len = udp->rx_buf_size;
+    }
+
+    return udp;
+}
+
+void dcp_udp_close(DCPUdp *udp) {
+    if (udp == NULL) return;
+
+    dcp_udp_flush(udp);
+    if (udp->scheduler) {
+        dcp_scheduler_remove_flush(udp->scheduler, &udp->flush_task);
+    }
+    if (udp->fd >= 0) close(udp->fd);
+    if (udp->rx_buf) udp->free_fn(udp->rx_buf);
+    if (udp->tx_buf) udp->free_fn(udp->tx_buf);
+    udp->free_fn(udp);
+}
+
+int dcp_udp_fd(const DCPUdp *udp) {
+    return udp ? udp->fd : -1;
+}
+
+int dcp_udp_attach(DCPUdp *udp, DCPCB *dcp, const struct sockaddr *addr,
+                   socklen_t addrlen) {
+    if (udp == NULL || dcp == NULL || addr == NULL) return -1;
+    if (addrlen > DCP_ADDR_MAX) return -2;
+
+    memcpy(dcp->peer_addr.data, addr, addrlen);
+    dcp->peer_addr.len = addrlen;
+    dcp->transport = udp;
+
+    dcp_set_output(dcp, NULL);
+    dcp_set_outputv(dcp, NULL);
+    dcp_set_output_batch(dcp, dcp_udp_output);
+
+    if (udp->scheduler == NULL) {
+        udp->scheduler = dcp->scheduler;
+        dcp_scheduler_add_flush(udp->scheduler, &udp->flush_task);
+    }
+
+    if (dcp->endpoint == NULL && dcp_endpoint_add(udp->endpoint, dcp) == DCP_HANDLE_INVALID) {
+        return -3;
+    }
+    return 0;
+}
+
+static uint32_t dcp_udp_gro_size(struct msghdr *msg) {
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cm), sizeof(size));
+            return (size > 0) ? (uint32_t)size : 0;
+        }
+    }
+    return 0;
+}
+
+int dcp_udp_recv(DCPUdp *udp, uint32_t now, int max_batches) {
+    if (udp == NULL) return -1;
+
+    int segments = 0;
+    for (int batch = 0; max_batches <= 0 || batch < max_batches; batch++) {
+        for (int i = 0; i < DCP_UDP_RX_BATCH; i++) {
+            struct msghdr *msg = &udp->rx_msgs[i].msg_hdr;
+            msg->msg_name = &udp->rx_addr[i];
+            msg->msg_namelen = sizeof(udp->rx_addr[i]);
+            msg->msg_iov = &udp->rx_iov[i];
+            msg->msg_iovlen = 1;
+            msg->msg_control = udp->rx_cmsg[i];
+            msg->msg_controllen = sizeof(udp->rx_cmsg[i]);
+            msg->msg_flags = 0;
+        }
+
+        int n = recvmmsg(udp->fd, udp->rx_msgs, DCP_UDP_RX_BATCH, MSG_DONTWAIT, NULL);
+        udp->stats.rx_syscalls++;
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct msghdr *msg = &udp->rx_msgs[i].msg_hdr;
+            const char *data = (const char*)udp->rx_iov[i].iov_base;
+            uint32_t len = udp->rx_msgs[i].msg_len;
+            uint32_t seg = dcp_udp_gro_size(msg);
+            if (seg == 0 || seg > len) seg = len;
+
+            udp->stats.rx_datagrams++;
+            for (uint32_t off = 0; off < len; off += seg) {
+                uint32_t part = (len - off < seg) ? len - off : seg;
+                udp->stats.rx_segments++;
+                segments++;
+                if (dcp_endpoint_input(udp->endpoint, data + off, part, &udp->rx_addr[i], now) < 0) {
+                    udp->stats.rx_dropped++;
+                }
+            }
+        }
+
+        if (n < DCP_UDP_RX_BATCH) break;
+    }
+
+    dcp_udp_flush(udp);
+    return segments;
+}
+
+void dcp_udp_get_stats(const DCPUdp *udp, DCPUdpStats *stats) {
+    if (udp == NULL || stats == NULL) return;
+    *stats = udp->stats;
+    stats->features = udp->features;
+}
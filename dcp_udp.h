@@ -0,0 +1,51 @@
+#ifndef __DCP_UDP_H__
+#define __DCP_UDP_H__
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "dcp.h"
+#include "dcp_endpoint.h"
+
+#define DCP_UDP_RX_BATCH      32
+#define DCP_UDP_RX_BUF        2048
+#define DCP_UDP_RX_GRO_BUF    65536
+#define DCP_UDP_TX_BATCH      64
+#define DCP_UDP_TX_BYTES      (256 * 1024)
+#define DCP_UDP_GSO_MAX_SEGS  64
+#define DCP_UDP_GSO_MAX_BYTES 65000
+
+#define DCP_UDP_GSO           0x1
+#define DCP_UDP_GRO           0x2
+
+typedef struct DCPUdp DCPUdp;
+
+typedef struct DCPUdpStats {
+    uint64_t rx_datagrams;
+    uint64_t rx_segments;
+    uint64_t rx_syscalls;
+    uint64_t rx_dropped;
+    uint64_t tx_segments;
+    uint64_t tx_datagrams;
+    uint64_t tx_syscalls;
+    uint64_t tx_errors;
+    uint64_t tx_dropped;
+    int features;
+} DCPUdpStats;
+
+DCPUdp* dcp_udp_open(DCPEndpoint *ep, const struct sockaddr *bind_addr,
+                     socklen_t addrlen, int features);
+
+void dcp_udp_close(DCPUdp *udp);
+
+int dcp_udp_fd(const DCPUdp *udp);
+
+int dcp_udp_attach(DCPUdp *udp, DCPCB *dcp, const struct sockaddr *addr,
+                   socklen_t addrlen);
+
+int dcp_udp_recv(DCPUdp *udp, uint32_t now, int max_batches);
+
+int dcp_udp_flush(DCPUdp *udp);
+
+void dcp_udp_get_stats(const DCPUdp *udp, DCPUdpStats *stats);
+
+#endif
@@ -0,0 +1,526 @@
+#define _GNU_SOURCE
+#include "dcp_uring.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#define DCP_URING_RECV_TAG  0xFFFFFFFFFFFFFFFFULL
+
+typedef struct DCPUringSend {
+    struct msghdr msg;
+    struct iovec iov[2];
+    struct sockaddr_in6 addr;
+    char header[DCP_OVERHEAD];
+    uint64_t seq;
+    int prev;
+    int next;
+    int next_free;
+} DCPUringSend;
+
+struct DCPUring {
+    int fd;
+    int ring_fd;
+    DCPEndpoint *endpoint;
+    DCPScheduler *scheduler;
+
+    dcp_malloc_fn alloc_fn;
+    dcp_free_fn free_fn;
+
+    void *sq_ptr;
+    size_t sq_len;
+    void *cq_ptr;
+    size_t cq_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+    unsigned sq_pending;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_len;
+    char *bufs;
+    uint16_t buf_tail;
+    int buf_registered;
+
+    struct msghdr recv_msg;
+    int recv_armed;
+
+    DCPUringSend *sends;
+    int send_free;
+    uint32_t send_inflight;
+    DCPRetireHold hold;
+    int send_head;
+    int send_tail;
+
+    DCPUringStats stats;
+};
+
+static int dcp_uring_setup(DCPUring *ring) {
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = DCP_URING_CQ_ENTRIES;
+    ring->ring_fd = (int)syscall(__NR_io_uring_setup, DCP_URING_SQ_ENTRIES, &p);
+    if (ring->ring_fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = DCP_URING_CQ_ENTRIES;
+        ring->ring_fd = (int)syscall(__NR_io_uring_setup, DCP_URING_SQ_ENTRIES, &p);
+    }
+    if (ring->ring_fd < 0) return -1;
+
+    ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) ring->sq_len = ring->cq_len;
+        ring->cq_len = 0;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return -2;
+    }
+
+    if (ring->cq_len == 0) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return -2;
+        }
+    }
+
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -2;
+    }
+
+    char *sq = (char*)ring->sq_ptr;
+    char *cq = (char*)ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    for (unsigned i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+    return 0;
+}
+
+static void dcp_uring_buf_add(DCPUring *ring, uint16_t bid) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (DCP_URING_BUF_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->bufs + (size_t)bid * DCP_URING_BUF_SIZE);
+    buf->len = DCP_URING_BUF_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+}
+
+static void dcp_uring_buf_publish(DCPUring *ring) {
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int dcp_uring_setup_bufs(DCPUring *ring) {
+    struct io_uring_buf_reg reg;
+
+    ring->buf_ring_len = DCP_URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    ring->buf_ring = (struct io_uring_buf_ring*)mmap(NULL, ring->buf_ring_len, PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+
+    ring->bufs = (char*)ring->alloc_fn((size_t)DCP_URING_BUF_COUNT * DCP_URING_BUF_SIZE);
+    if (ring->bufs == NULL) return -1;
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = DCP_URING_BUF_COUNT;
+    reg.bgid = DCP_URING_BUF_GROUP;
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -2;
+    }
+    ring->buf_registered = 1;
+
+    for (int i = 0; i < DCP_URING_BUF_COUNT; i++) {
+        dcp_uring_buf_add(ring, (uint16_t)i);
+    }
+    dcp_uring_buf_publish(ring);
+    return 0;
+}
+
+static struct io_uring_sqe* dcp_uring_get_sqe(DCPUring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) return NULL;
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    ring->sq_local_tail++;
+    ring->sq_pending++;
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+static int dcp_uring_enter(DCPUring *ring, uint32_t wait_us) {
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    unsigned min_complete = 0;
+    void *argp = NULL;
+    size_t argsz = 0;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (wait_us > 0) {
+        ts.tv_sec = wait_us / 1000000;
+        ts.tv_nsec = (long long)(wait_us % 1000000) * 1000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        min_complete = 1;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    ring->stats.enters++;
+    int ret = (int)syscall(__NR_io_uring_enter, ring->ring_fd, ring->sq_pending, min_complete,
+                           flags, argp, argsz);
+    if (ret < 0) {
+        return (errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN) ? 0 : -1;
+    }
+    ring->sq_pending -= (unsigned)ret;
+    return 0;
+}
+
+static int dcp_uring_arm_recv(DCPUring *ring) {
+    struct io_uring_sqe *sqe = dcp_uring_get_sqe(ring);
+    if (sqe == NULL) return -1;
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = ring->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring->recv_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = DCP_URING_BUF_GROUP;
+    sqe->user_data = DCP_URING_RECV_TAG;
+
+    ring->recv_armed = 1;
+    ring->stats.rx_rearms++;
+    return 0;
+}
+
+static void dcp_uring_on_send(DCPUring *ring, const struct io_uring_cqe *cqe) {
+    int index = (int)cqe->user_data;
+    DCPUringSend *s = &ring->sends[index];
+
+    if (cqe->res < 0) {
+        ring->stats.tx_errors++;
+    } else {
+        ring->stats.tx_packets++;
+    }
+
+    if (s->prev >= 0) {
+        ring->sends[s->prev].next = s->next;
+    } else {
+        ring->send_head = s->next;
+        ring->hold.oldest = (s->next >= 0) ? ring->sends[s->next].seq : UINT64_MAX;
+    }
+    if (s->next >= 0) {
+        ring->sends[s->next].prev = s->prev;
+    } else {
+        ring->send_tail = s->prev;
+    }
+
+    s->next_free = ring->send_free;
+    ring->send_free = index;
+    ring->send_inflight--;
+}
+
+static void dcp_uring_reap_sends(DCPUring *ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned keep = tail;
+
+    for (unsigned i = tail; i != head; i--) {
+        const struct io_uring_cqe *cqe = &ring->cqes[(i - 1) & ring->cq_mask];
+        if (cqe->user_data != DCP_URING_RECV_TAG) {
+            dcp_uring_on_send(ring, cqe);
+        } else if (--keep != i - 1) {
+            ring->cqes[keep & ring->cq_mask] = *cqe;
+        }
+    }
+    __atomic_store_n(ring->cq_head, keep, __ATOMIC_RELEASE);
+}
+
+static int dcp_uring_outputv(const struct iovec *iov, int iovcnt, DCPCB *dcp, void *user) {
+    DCPUring *ring = (DCPUring*)dcp->transport;
+    (void)user;
+
+    if (ring == NULL || dcp->peer_addr.len == 0) return -1;
+    if (iov[0].iov_len > DCP_OVERHEAD) return -1;
+
+    struct io_uring_sqe *sqe = NULL;
+    if (ring->send_free >= 0) {
+        sqe = dcp_uring_get_sqe(ring);
+    }
+    if (sqe == NULL) {
+        ring->stats.tx_stalls++;
+        dcp_uring_enter(ring, 0);
+        dcp_uring_reap_sends(ring);
+        if (ring->send_free >= 0) {
+            sqe = dcp_uring_get_sqe(ring);
+        }
+        if (sqe == NULL) {
+            ring->stats.tx_dropped++;
+            return -2;
+        }
+    }
+
+    int index = ring->send_free;
+    DCPUringSend *s = &ring->sends[index];
+    ring->send_free = s->next_free;
+
+    memcpy(s->header, iov[0].iov_base, iov[0].iov_len);
+    s->iov[0].iov_base = s->header;
+    s->iov[0].iov_len = iov[0].iov_len;
+    if (iovcnt > 1) {
+        s->iov[1] = iov[1];
+    }
+    memcpy(&s->addr, dcp->peer_addr.data, dcp->peer_addr.len);
+
+    memset(&s->msg, 0, sizeof(struct msghdr));
+    s->msg.msg_name = &s->addr;
+    s->msg.msg_namelen = dcp->peer_addr.len;
+    s->msg.msg_iov = s->iov;
+    s->msg.msg_iovlen = (iovcnt > 1) ? 2 : 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = ring->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = (uint64_t)index;
+
+    s->seq = ring->scheduler->retire_seq++;
+    s->prev = ring->send_tail;
+    s->next = -1;
+    if (ring->send_tail >= 0) {
+        ring->sends[ring->send_tail].next = index;
+    } else {
+        ring->send_head = index;
+        ring->hold.oldest = s->seq;
+    }
+    ring->send_tail = index;
+    ring->send_inflight++;
+    return 0;
+}
+
+static int dcp_uring_on_recv(DCPUring *ring, const struct io_uring_cqe *cqe, uint32_t now) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        ring->recv_armed = 0;
+    }
+    if (cqe->res < 0) {
+        if (cqe->res == -ENOBUFS) ring->stats.rx_nobufs++;
+        return 0;
+    }
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) return 0;
+
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    char *buf = ring->bufs + (size_t)bid * DCP_URING_BUF_SIZE;
+    struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out*)buf;
+    char *name = buf + sizeof(struct io_uring_recvmsg_out);
+    char *payload = name + ring->recv_msg.msg_namelen + ring->recv_msg.msg_controllen;
+    int handled = 0;
+
+    if (out->flags & MSG_TRUNC) {
+        ring->stats.rx_dropped++;
+    } else {
+        ring->stats.rx_packets++;
+        handled = 1;
+        if (dcp_endpoint_input(ring->endpoint, payload, out->payloadlen, name, now) < 0) {
+            ring->stats.rx_dropped++;
+        }
+    }
+
+    dcp_uring_buf_add(ring, bid);
+    return handled;
+}
+
+static int dcp_uring_reap(DCPUring *ring, uint32_t now) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int received = 0;
+
+    for (unsigned i = head; i != tail; i++) {
+        const struct io_uring_cqe *cqe = &ring->cqes[i & ring->cq_mask];
+        if (cqe->user_data != DCP_URING_RECV_TAG) {
+            dcp_uring_on_send(ring, cqe);
+        }
+    }
+
+    dcp_scheduler_reclaim(ring->scheduler);
+
+    for (unsigned i = head; i != tail; i++) {
+        const struct io_uring_cqe *cqe = &ring->cqes[i & ring->cq_mask];
+        if (cqe->user_data == DCP_URING_RECV_TAG) {
+            received += dcp_uring_on_recv(ring, cqe, now);
+        }
+    }
+
+    __atomic_store_n(ring->cq_head, tail, __ATOMIC_RELEASE);
+    dcp_uring_buf_publish(ring);
+    return received;
+}
+
+DCPUring* dcp_uring_open(DCPEndpoint *ep, DCPScheduler *scheduler,
+                         const struct sockaddr *bind_addr, socklen_t addrlen) {
+    dcp_malloc_fn malloc_fn = dcp_get_malloc();
+
+    if (ep == NULL || scheduler == NULL || bind_addr == NULL) return NULL;
+
+    DCPUring *ring = (DCPUring*)malloc_fn(sizeof(DCPUring));
+    if (ring == NULL) return NULL;
+
+    memset(ring, 0, sizeof(DCPUring));
+    ring->alloc_fn = malloc_fn;
+    ring->free_fn = dcp_get_free();
+    ring->endpoint = ep;
+    ring->scheduler = scheduler;
+    ring->ring_fd = -1;
+
+    ring->fd = socket(bind_addr->sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ring->fd < 0 || bind(ring->fd, bind_addr, addrlen) < 0 ||
+        dcp_uring_setup(ring) < 0 || dcp_uring_setup_bufs(ring) < 0) {
+        dcp_uring_close(ring);
+        return NULL;
+    }
+
+    ring->sends = (DCPUringSend*)malloc_fn(DCP_URING_SEND_SLOTS * sizeof(DCPUringSend));
+    if (ring->sends == NULL) {
+        dcp_uring_close(ring);
+        return NULL;
+    }
+    for (int i = 0; i < DCP_URING_SEND_SLOTS; i++) {
+        ring->sends[i].next_free = (i + 1 < DCP_URING_SEND_SLOTS) ? i + 1 : -1;
+    }
+    ring->send_free = 0;
+    ring->send_head = -1;
+    ring->send_tail = -1;
+
+    ring->recv_msg.msg_namelen = sizeof(struct sockaddr_in6);
+    ring->recv_msg.msg_controllen = 0;
+
+    dcp_scheduler_add_hold(scheduler, &ring->hold);
+    return ring;
+}
+
+static void dcp_uring_drain(DCPUring *ring) {
+    for (int i = 0; i < DCP_URING_DRAIN_TRIES && ring->send_inflight > 0; i++) {
+        if (dcp_uring_enter(ring, DCP_URING_DRAIN_WAIT) < 0) break;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            if (cqe->user_data != DCP_URING_RECV_TAG) {
+                dcp_uring_on_send(ring, cqe);
+            }
+        }
+        __atomic_store_n(ring->cq_head, tail, __ATOMIC_RELEASE);
+    }
+}
+
+void dcp_uring_close(DCPUring *ring) {
+    if (ring == NULL) return;
+
+    if (ring->sends && ring->cqes) {
+        dcp_uring_drain(ring);
+    }
+    if (ring->ring_fd >= 0) close(ring->ring_fd);
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_len);
+    if (ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_len);
+    if (ring->buf_ring) munmap(ring->buf_ring, ring->buf_ring_len);
+    if (ring->fd >= 0) close(ring->fd);
+
+    if (ring->sends) {
+        dcp_scheduler_remove_hold(ring->scheduler, &ring->hold);
+        ring->free_fn(ring->sends);
+    }
+    if (ring->bufs) ring->free_fn(ring->bufs);
+    ring->free_fn(ring);
+}
+
+int dcp_uring_fd(const DCPUring *ring) {
+    return ring ? ring->ring_fd : -1;
+}
+
+int dcp_uring_attach(DCPUring *ring, DCPCB *dcp, const struct sockaddr *addr,
+                     socklen_t addrlen) {
+    if (ring == NULL || dcp == NULL || addr == NULL) return -1;
+    if (addrlen > DCP_ADDR_MAX) return -2;
+    if (dcp->scheduler != ring->scheduler) return -4;
+
+    memcpy(dcp->peer_addr.data, addr, addrlen);
+    dcp->peer_addr.len = addrlen;
+    dcp->transport = ring;
+
+    dcp_set_output(dcp, NULL);
+    dcp_set_output_batch(dcp, NULL);
+    dcp_set_outputv(dcp, dcp_uring_outputv);
+
+    if (dcp->endpoint == NULL && dcp_endpoint_add(ring->endpoint, dcp) == DCP_HANDLE_INVALID) {
+        return -3;
+    }
+    return 0;
+}
+
+int dcp_uring_tick(DCPUring *ring, uint64_t now_us, uint32_t wait_us) {
+    if (ring == NULL) return -1;
+
+    dcp_scheduler_run_us(ring->scheduler, now_us);
+    int received = dcp_uring_reap(ring, (uint32_t)(now_us / 1000));
+    dcp_scheduler_run_us(ring->scheduler, now_us);
+
+    if (!ring->recv_armed) {
+        dcp_uring_arm_recv(ring);
+    }
+    if (dcp_uring_enter(ring, wait_us) < 0) return -2;
+    return received;
+}
+
+void dcp_uring_get_stats(const DCPUring *ring, DCPUringStats *stats) {
+    if (ring == NULL || stats == NULL) return;
+    *stats = ring->stats;
+}
@@ -0,0 +1,46 @@
+#ifndef __DCP_URING_H__
+#define __DCP_URING_H__
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "dcp.h"
+#include "dcp_endpoint.h"
+
+#define DCP_URING_SQ_ENTRIES   512
+#define DCP_URING_CQ_ENTRIES   4096
+#define DCP_URING_SEND_SLOTS   1024
+#define DCP_URING_BUF_COUNT    512
+#define DCP_URING_BUF_SIZE     2048
+#define DCP_URING_BUF_GROUP    0
+#define DCP_URING_DRAIN_TRIES  64
+#define DCP_URING_DRAIN_WAIT   1000
+
+typedef struct DCPUring DCPUring;
+
+typedef struct DCPUringStats {
+    uint64_t enters;
+    uint64_t rx_packets;
+    uint64_t rx_dropped;
+    uint64_t rx_nobufs;
+    uint64_t rx_rearms;
+    uint64_t tx_packets;
+    uint64_t tx_errors;
+    uint64_t tx_stalls;
+    uint64_t tx_dropped;
+} DCPUringStats;
+
+DCPUring* dcp_uring_open(DCPEndpoint *ep, DCPScheduler *scheduler,
+                         const struct sockaddr *bind_addr, socklen_t addrlen);
+
+void dcp_uring_close(DCPUring *ring);
+
+int dcp_uring_fd(const DCPUring *ring);
+
+int dcp_uring_attach(DCPUring *ring, DCPCB *dcp, const struct sockaddr *addr,
+                     socklen_t addrlen);
+
+int dcp_uring_tick(DCPUring *ring, uint64_t now_us, uint32_t wait_us);
+
+void dcp_uring_get_stats(const DCPUring *ring, DCPUringStats *stats);
+
+#endif
@@ -0,0 +1,475 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+extern "C" {
+#include "dcp_allocator.h"
+#include "dcp_scheduler.h"
+#include "dcp_trace.h"
+#include "dcp_fec.h"
+#include "dcp.h"
+
+char* dcp_bench_encode_seg(const DCPCB *dcp, char *ptr, const DCPSEG *seg);
+const char* dcp_bench_decode_seg(DCPCB *dcp, const char *ptr, long size, DCPSEG *seg, uint32_t now);
+}
+
+static uint64_t g_mallocs;
+static volatile uintptr_t g_sink;
+static const char *g_filter;
+static int g_miss_fd = -1;
+
+static void* bench_malloc(size_t size) {
+    g_mallocs++;
+    return malloc(size);
+}
+
+static void bench_free(void *ptr) {
+    free(ptr);
+}
+
+static int bench_output(const char *buf, int len, DCPCB *dcp, void *user) {
+    (void)dcp;
+    (void)user;
+    g_sink += (uintptr_t)buf[0] + (uintptr_t)len;
+    return 0;
+}
+
+static void bench_timer_cb(DCPCB *dcp, uint32_t now) {
+    (void)dcp;
+    g_sink += now;
+}
+
+static uint64_t bench_clock_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void bench_open_counters() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    g_miss_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (g_miss_fd >= 0) {
+        ioctl(g_miss_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static int64_t bench_cache_misses() {
+    uint64_t value = 0;
+    if (g_miss_fd < 0 || read(g_miss_fd, &value, sizeof(value)) != sizeof(value)) return -1;
+    return (int64_t)value;
+}
+
+static uint64_t bench_pool_allocs(const DCPScheduler *scheduler) {
+    DCPPoolStats stats;
+    if (scheduler == nullptr) return 0;
+    dcp_pool_get_stats(scheduler->seg_pool, &stats);
+    return stats.allocs;
+}
+
+struct BenchMeter {
+    const DCPScheduler *scheduler = nullptr;
+    uint64_t ns = 0;
+    uint64_t mallocs = 0;
+    uint64_t pool = 0;
+    int64_t misses = 0;
+
+    uint64_t t0 = 0, m0 = 0, p0 = 0;
+    int64_t c0 = 0;
+
+    void start() {
+        m0 = g_mallocs;
+        p0 = bench_pool_allocs(scheduler);
+        c0 = bench_cache_misses();
+        t0 = bench_clock_ns();
+    }
+
+    void stop() {
+        uint64_t t1 = bench_clock_ns();
+        int64_t c1 = bench_cache_misses();
+        ns += t1 - t0;
+        mallocs += g_mallocs - m0;
+        pool += bench_pool_allocs(scheduler) - p0;
+        if (c0 < 0 || c1 < 0) misses = -1;
+        else if (misses >= 0) misses += c1 - c0;
+    }
+
+    void report(const char *name, uint64_t ops) const {
+        char miss[32];
+        if (misses < 0) snprintf(miss, sizeof(miss), "%12s", "n/a");
+        else snprintf(miss, sizeof(miss), "%12.2f", (double)misses / ops);
+        printf("%-34s %12llu %10.1f %10.3f %10.3f %s\n", name, (unsigned long long)ops,
+               (double)ns / ops, (double)mallocs / ops, (double)pool / ops, miss);
+    }
+};
+
+static bool bench_enabled(const char *name) {
+    return g_filter == nullptr || strstr(name, g_filter) != nullptr;
+}
+
+static uint32_t bench_rand(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(*state >> 33);
+}
+
+static void bench_timers(uint32_t count) {
+    char name[64];
+    uint64_t rng = count;
+    std::vector<DCPTimerNode> nodes(count);
+    std::vector<uint32_t> timeouts(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        dcp_timer_init(&nodes[i], nullptr, bench_timer_cb);
+        timeouts[i] = 1000 + bench_rand(&rng) % 10000000;
+    }
+
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    BenchMeter add;
+    add.scheduler = scheduler;
+    add.start();
+    for (uint32_t i = 0; i < count; i++) {
+        dcp_scheduler_add_us(scheduler, &nodes[i], timeouts[i]);
+    }
+    add.stop();
+    snprintf(name, sizeof(name), "scheduler_add/%u", count);
+    if (bench_enabled(name)) add.report(name, count);
+
+    BenchMeter resched;
+    resched.scheduler = scheduler;
+    resched.start();
+    for (uint32_t i = 0; i < count; i++) {
+        dcp_scheduler_add_us(scheduler, &nodes[i], timeouts[count - 1 - i]);
+    }
+    resched.stop();
+    snprintf(name, sizeof(name), "scheduler_readd/%u", count);
+    if (bench_enabled(name)) resched.report(name, count);
+
+    BenchMeter run;
+    run.scheduler = scheduler;
+    run.start();
+    for (uint64_t now = 0; now <= 11000000 && scheduler->timer_count > 0; now += 1000) {
+        dcp_scheduler_run_us(scheduler, now);
+    }
+    run.stop();
+    snprintf(name, sizeof(name), "scheduler_run/%u", count);
+    if (bench_enabled(name)) run.report(name, count);
+
+    dcp_scheduler_release(scheduler);
+}
+
+static void bench_codec(int compact) {
+    const uint64_t iterations = 10000000;
+    char buf[DCP_OVERHEAD + 16];
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    DCPCB *dcp = dcp_create(7, 0, nullptr, scheduler);
+    DCPSEG seg;
+
+    dcp->hdr_compact = compact;
+    dcp->hdr_compact_peer = compact;
+    memset(&seg, 0, sizeof(seg));
+    seg.conv_id = 7;
+    seg.cmd = DCP_CMD_PUSH;
+    seg.wnd = 256;
+    seg.una = 0;
+
+    BenchMeter enc;
+    enc.scheduler = scheduler;
+    enc.start();
+    for (uint64_t i = 0; i < iterations; i++) {
+        seg.sn = (uint32_t)i & 0x3FFF;
+        seg.ts = (uint32_t)i;
+        seg.frg = (uint32_t)i & 3;
+        g_sink += (uintptr_t)(dcp_bench_encode_seg(dcp, buf, &seg) - buf);
+    }
+    enc.stop();
+
+    seg.sn = 100;
+    seg.frg = 2;
+    long len = (long)(dcp_bench_encode_seg(dcp, buf, &seg) - buf);
+    dcp->rcv_nxt = 90;
+
+    BenchMeter dec;
+    dec.scheduler = scheduler;
+    dec.start();
+    for (uint64_t i = 0; i < iterations; i++) {
+        DCPSEG out;
+        const char *p = dcp_bench_decode_seg(dcp, buf, len, &out, 1000);
+        g_sink += (uintptr_t)p + out.sn;
+    }
+    dec.stop();
+
+    const char *enc_name = compact ? "encode_seg/compact" : "encode_seg/full";
+    const char *dec_name = compact ? "decode_seg/compact" : "decode_seg/full";
+    if (bench_enabled(enc_name)) enc.report(enc_name, iterations);
+    if (bench_enabled(dec_name)) dec.report(dec_name, iterations);
+
+    dcp_release(dcp);
+    dcp_scheduler_release(scheduler);
+}
+
+static std::vector<std::string> bench_make_push(uint32_t count, int payload, int frg_span) {
+    std::vector<std::string> packets;
+    std::vector<char> data(payload, 'x');
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    DCPCB *sender = dcp_create(9, 0, nullptr, scheduler);
+    char buf[DCP_OVERHEAD];
+    DCPSEG seg;
+
+    memset(&seg, 0, sizeof(seg));
+    seg.conv_id = 9;
+    seg.cmd = DCP_CMD_PUSH;
+    seg.wnd = 4096;
+    for (uint32_t i = 0; i < count; i++) {
+        seg.sn = i;
+        seg.ts = 1000;
+        seg.frg = (frg_span > 1) ? (uint32_t)(frg_span - 1 - (int)(i % frg_span)) : 0;
+        seg.len = (uint32_t)payload;
+        char *end = dcp_bench_encode_seg(sender, buf, &seg);
+        std::string pkt(buf, end - buf);
+        pkt.append(data.data(), payload);
+        packets.push_back(pkt);
+    }
+
+    dcp_release(sender);
+    dcp_scheduler_release(scheduler);
+    return packets;
+}
+
+static void bench_input(const char *name, const std::vector<std::string> &packets,
+                        const std::vector<uint32_t> &order) {
+    if (!bench_enabled(name)) return;
+
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    DCPCB *dcp = dcp_create(9, 0, nullptr, scheduler);
+    char rbuf[2048];
+
+    dcp_set_output(dcp, bench_output);
+    dcp_wndsize(dcp, 256, 4096);
+
+    BenchMeter meter;
+    meter.scheduler = scheduler;
+    for (size_t i = 0; i < order.size(); i += 64) {
+        size_t end = (i + 64 < order.size()) ? i + 64 : order.size();
+        meter.start();
+        for (size_t j = i; j < end; j++) {
+            const std::string &pkt = packets[order[j]];
+            dcp_input(dcp, pkt.data(), (long)pkt.size(), 1000);
+        }
+        meter.stop();
+        while (dcp_recv(dcp, rbuf, sizeof(rbuf)) > 0) {
+        }
+    }
+    meter.report(name, order.size());
+
+    dcp_release(dcp);
+    dcp_scheduler_release(scheduler);
+}
+
+static void bench_inputs() {
+    const uint32_t count = 200000;
+    std::vector<std::string> packets = bench_make_push(count, 1200, 1);
+    std::vector<uint32_t> order;
+
+    for (uint32_t i = 0; i < count; i++) order.push_back(i);
+    bench_input("input_push/in_order", packets, order);
+
+    order.clear();
+    for (uint32_t i = 0; i < count; i += 8) {
+        for (uint32_t j = 8; j > 0; j--) {
+            if (i + j - 1 < count) order.push_back(i + j - 1);
+        }
+    }
+    bench_input("input_push/reordered", packets, order);
+
+    order.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        order.push_back(i);
+        order.push_back(i);
+    }
+    bench_input("input_push/duplicate", packets, order);
+}
+
+static void bench_send(int size) {
+    char name[64];
+    snprintf(name, sizeof(name), "send_fragment/%d", size);
+    if (!bench_enabled(name)) return;
+
+    std::vector<char> msg(size, 'y');
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    BenchMeter meter;
+    meter.scheduler = scheduler;
+    uint64_t ops = 0;
+
+    while (ops < 200000) {
+        DCPCB *dcp = dcp_create(11, 0, nullptr, scheduler);
+        dcp_set_output(dcp, bench_output);
+        dcp_wndsize(dcp, 8192, 0);
+
+        meter.start();
+        int sent = 0;
+        while (dcp_send(dcp, msg.data(), size, 1000) == 0) {
+            sent++;
+        }
+        meter.stop();
+
+        ops += sent;
+        dcp_release(dcp);
+        if (sent == 0) break;
+    }
+    if (ops > 0) meter.report(name, ops);
+    dcp_scheduler_release(scheduler);
+}
+
+static void bench_recv(int frags) {
+    char name[64];
+    snprintf(name, sizeof(name), "recv_reassemble/%dx1200", frags);
+    if (!bench_enabled(name)) return;
+
+    const uint32_t messages = 2000;
+    std::vector<std::string> packets = bench_make_push(messages * frags, 1200, frags);
+    std::vector<char> rbuf(frags * 1200);
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    DCPCB *dcp = dcp_create(9, 0, nullptr, scheduler);
+    BenchMeter meter;
+    meter.scheduler = scheduler;
+    uint64_t ops = 0;
+
+    dcp_set_output(dcp, bench_output);
+    dcp_wndsize(dcp, 256, 4096);
+
+    uint32_t batch = 1024 / frags;
+    for (uint32_t m = 0; m < messages; m += batch) {
+        uint32_t end = (m + batch < messages) ? m + batch : messages;
+        for (uint32_t i = m * frags; i < end * frags; i++) {
+            dcp_input(dcp, packets[i].data(), (long)packets[i].size(), 1000);
+        }
+        meter.start();
+        while (dcp_recv(dcp, rbuf.data(), (int)rbuf.size()) > 0) {
+            ops++;
+        }
+        meter.stop();
+    }
+    meter.report(name, ops);
+
+    dcp_release(dcp);
+    dcp_scheduler_release(scheduler);
+}
+
+static void bench_trace() {
+    const uint64_t iterations = 10000000;
+    if (!bench_enabled("trace_record")) return;
+
+    DCPTrace *trace = dcp_trace_create(1 << 16);
+    BenchMeter meter;
+    meter.start();
+    for (uint64_t i = 0; i < iterations; i++) {
+        dcp_trace_record(trace, DCP_TRACE_PKT_SENT, i, 7, (uint32_t)i, 1200, i << 4, 0);
+    }
+    meter.stop();
+    g_sink = (uintptr_t)trace->committed;
+    meter.report("trace_record", iterations);
+    dcp_trace_release(trace);
+}
+
+static void bench_fec(int level) {
+    const uint64_t iterations = 20000;
+    const uint32_t k = 16, m = 2, len = DCP_MTU_DEF - DCP_OVERHEAD - DCP_FEC_OVERHEAD;
+    static const char *levels[] = { "scalar", "ssse3", "avx2" };
+    char enc_name[64], dec_name[64];
+
+    if (dcp_fec_set_simd(level) != level) return;
+    snprintf(enc_name, sizeof(enc_name), "fec_encode_k%um%u/%s", k, m, levels[level]);
+    snprintf(dec_name, sizeof(dec_name), "fec_recover_k%um%u/%s", k, m, levels[level]);
+
+    std::vector<std::string> data(k, std::string(len, 0));
+    uint64_t state = 7;
+    for (auto &d : data) {
+        for (auto &c : d) c = (char)bench_rand(&state);
+    }
+
+    DCPFecEncoder *enc = dcp_fec_encoder_create(k, m, len + DCP_FEC_SYM_HDR);
+    DCPFecDecoder *dec = dcp_fec_decoder_create(len + DCP_FEC_SYM_HDR, 4 * k);
+
+    if (bench_enabled(enc_name)) {
+        BenchMeter meter;
+        meter.start();
+        for (uint64_t i = 0; i < iterations; i++) {
+            for (uint32_t j = 0; j < k; j++) {
+                dcp_fec_encode(enc, (uint32_t)(i * k + j), 0, data[j].data(), len);
+            }
+            g_sink += dcp_fec_encoder_parity(enc, 0)[i % len];
+            dcp_fec_encoder_reset(enc);
+        }
+        meter.stop();
+        meter.report(enc_name, iterations);
+    }
+
+    if (bench_enabled(dec_name)) {
+        for (uint32_t j = 0; j < k; j++) {
+            dcp_fec_encode(enc, j, 0, data[j].data(), len);
+        }
+        for (uint32_t j = 2; j < k; j++) {
+            dcp_fec_decoder_store(dec, j, 0, data[j].data(), len);
+        }
+
+        BenchMeter meter;
+        meter.start();
+        for (uint64_t i = 0; i < iterations; i++) {
+            uint32_t base = 0;
+            for (uint32_t j = 0; j < m; j++) {
+                dcp_fec_decoder_parity(dec, 0, k, j, (const char*)dcp_fec_encoder_parity(enc, j),
+                                       enc->sym_len);
+            }
+            g_sink += dcp_fec_decoder_recover(dec, dcp_fec_decoder_find(dec, 0), &base);
+            dec->cache_len[0] = 0;
+            dec->cache_len[1] = 0;
+        }
+        meter.stop();
+        meter.report(dec_name, iterations);
+        dcp_fec_encoder_reset(enc);
+    }
+
+    dcp_fec_encoder_release(enc);
+    dcp_fec_decoder_release(dec);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) g_filter = argv[1];
+
+    dcp_set_allocator(bench_malloc, bench_free);
+    bench_open_counters();
+
+    printf("%-34s %12s %10s %10s %10s %12s\n", "benchmark", "ops", "ns/op", "malloc/op",
+           "pool/op", "llc-miss/op");
+
+    bench_timers(10000);
+    bench_timers(100000);
+    bench_timers(1000000);
+    bench_codec(0);
+    bench_codec(1);
+    bench_inputs();
+    bench_send(1000);
+    bench_send(16 * 1024);
+    bench_send(64 * 1024);
+    bench_recv(4);
+    bench_recv(16);
+    bench_trace();
+    bench_fec(DCP_FEC_SIMD_SCALAR);
+    bench_fec(DCP_FEC_SIMD_SSSE3);
+    bench_fec(DCP_FEC_SIMD_AVX2);
+
+    if (g_miss_fd >= 0) close(g_miss_fd);
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include "../dcp.c"
+
+char* dcp_bench_encode_seg(const DCPCB *dcp, char *ptr, const DCPSEG *seg) {
+    return dcp_encode_seg(dcp, ptr, seg);
+}
+
+const char* dcp_bench_decode_seg(DCPCB *dcp, const char *ptr, long size, DCPSEG *seg, uint32_t now) {
+    return dcp_decode_seg(dcp, ptr, size, seg, now);
+}
@@ -0,0 +1,844 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <queue>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+extern "C" {
+#include "dcp_allocator.h"
+#include "dcp_scheduler.h"
+#include "dcp.h"
+#include "dcp_fec.h"
+#include "dcp_runtime.h"
+#include "dcp_udp.h"
+#include "dcp_uring.h"
+#include "dcp_loop.h"
+}
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+} while (0)
+
+#define CHECK_SKIP 2
+
+static const char *g_filter;
+
+struct CheckNet;
+
+typedef int (*check_filter_fn)(CheckNet *net, int from_b, uint64_t index, const char *data, int len);
+
+struct CheckPacket {
+    uint64_t at_us;
+    uint64_t order;
+    int to_b;
+    std::string data;
+};
+
+struct CheckPacketLater {
+    bool operator()(const CheckPacket &a, const CheckPacket &b) const {
+        return (a.at_us != b.at_us) ? a.at_us > b.at_us : a.order > b.order;
+    }
+};
+
+struct CheckEndpoint {
+    CheckNet *net;
+    int is_b;
+};
+
+struct CheckNet {
+    DCPScheduler *scheduler = nullptr;
+    DCPCB *a = nullptr;
+    DCPCB *b = nullptr;
+    CheckEndpoint ends[2];
+    uint64_t now_us = 0;
+    uint64_t order = 0;
+    uint32_t delay_us = 10000;
+    check_filter_fn filter = nullptr;
+    void *arg = nullptr;
+    uint64_t sent[2] = {0, 0};
+    uint64_t dropped[2] = {0, 0};
+    std::priority_queue<CheckPacket, std::vector<CheckPacket>, CheckPacketLater> wire;
+    std::string tx;
+    size_t tx_off = 0;
+    int msg = 1000;
+    std::string rx;
+    uint64_t rx_msgs = 0;
+
+    ~CheckNet() {
+        if (scheduler == nullptr) return;
+        dcp_release(a);
+        dcp_release(b);
+        dcp_scheduler_release(scheduler);
+    }
+};
+
+static int check_output(const char *buffer, int len, DCPCB *dcp, void *user) {
+    CheckEndpoint *ep = (CheckEndpoint*)user;
+    CheckNet *net = ep->net;
+    uint64_t index = net->sent[ep->is_b]++;
+    int extra = 0;
+    (void)dcp;
+
+    if (net->filter != nullptr) {
+        extra = net->filter(net, ep->is_b, index, buffer, len);
+    }
+    if (extra < 0) {
+        net->dropped[ep->is_b]++;
+        return 0;
+    }
+
+    CheckPacket pkt;
+    pkt.at_us = net->now_us + net->delay_us + (uint32_t)extra;
+    pkt.order = net->order++;
+    pkt.to_b = !ep->is_b;
+    pkt.data.assign(buffer, len);
+    net->wire.push(pkt);
+    return 0;
+}
+
+static void check_net_init(CheckNet *net, uint32_t conv) {
+    net->scheduler = dcp_scheduler_create();
+    net->ends[0] = CheckEndpoint{net, 0};
+    net->ends[1] = CheckEndpoint{net, 1};
+    net->a = dcp_create(conv, 0, &net->ends[0], net->scheduler);
+    net->b = dcp_create(conv, 0, &net->ends[1], net->scheduler);
+    dcp_set_output(net->a, check_output);
+    dcp_set_output(net->b, check_output);
+}
+
+static void check_net_service(CheckNet *net) {
+    static char buf[65536];
+    int n;
+    while ((n = dcp_recv(net->b, buf, sizeof(buf))) > 0) {
+        net->rx.append(buf, n);
+        net->rx_msgs++;
+    }
+
+    uint32_t now_ms = (uint32_t)(net->now_us / 1000);
+    while (net->tx_off < net->tx.size() && net->a->snd_queue_len < net->a->snd_wnd) {
+        size_t len = net->tx.size() - net->tx_off;
+        if (len > (size_t)net->msg) len = net->msg;
+        if (dcp_send(net->a, net->tx.data() + net->tx_off, (int)len, now_ms) != 0) break;
+        net->tx_off += len;
+    }
+}
+
+static void check_net_run(CheckNet *net, uint64_t limit_us) {
+    uint64_t end_us = net->now_us + limit_us;
+
+    check_net_service(net);
+    while (net->rx.size() < net->tx.size() && net->now_us < end_us) {
+        uint64_t next = end_us;
+        if (!net->wire.empty() && net->wire.top().at_us < next) next = net->wire.top().at_us;
+
+        uint64_t expiry = dcp_scheduler_next_expiry_us(net->scheduler);
+        if (expiry < next) next = expiry;
+        if (next > net->now_us) net->now_us = next;
+        dcp_scheduler_run_us(net->scheduler, net->now_us);
+
+        uint32_t now_ms = (uint32_t)(net->now_us / 1000);
+        while (!net->wire.empty() && net->wire.top().at_us <= net->now_us) {
+            CheckPacket pkt = net->wire.top();
+            net->wire.pop();
+            dcp_input(pkt.to_b ? net->b : net->a, pkt.data.data(), (long)pkt.data.size(), now_ms);
+        }
+
+        dcp_scheduler_run_us(net->scheduler, net->now_us);
+        check_net_service(net);
+    }
+}
+
+static std::string check_payload(size_t len, uint32_t seed) {
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        s[i] = (char)(seed >> 16);
+    }
+    return s;
+}
+
+static int check_clean_link() {
+    CheckNet net;
+    check_net_init(&net, 1);
+
+    net.tx = check_payload(256 * 1024, 1);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(stats.segs_retrans == 0);
+    CHECK(stats.segs_sent == (net.tx.size() + 999) / 1000);
+    return 0;
+}
+
+static int check_reorder_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    (void)net;
+    (void)data;
+    (void)len;
+    return (!from_b && index % 7 == 3) ? 3000 : 0;
+}
+
+static int check_reorder_only() {
+    CheckNet net;
+    check_net_init(&net, 2);
+    net.filter = check_reorder_filter;
+
+    net.tx = check_payload(512 * 1024, 2);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(stats.segs_retrans == 0);
+    CHECK(stats.rto_timeouts == 0);
+    return 0;
+}
+
+static int check_drop_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    (void)net;
+    (void)data;
+    (void)len;
+    return (!from_b && index % 20 == 10) ? -1 : 0;
+}
+
+static int check_sack_wrap() {
+    CheckNet net;
+    check_net_init(&net, 3);
+    net.filter = check_drop_filter;
+    net.a->snd_una = net.a->snd_nxt = 0xFFFFFF00u;
+    net.b->rcv_nxt = 0xFFFFFF00u;
+
+    net.tx = check_payload(512 * 1024, 3);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(net.a->snd_una < 0x1000u);
+    CHECK(net.dropped[0] > 0);
+    CHECK(stats.segs_retrans == net.dropped[0]);
+    CHECK(stats.rto_timeouts == 0);
+    return 0;
+}
+
+static int check_scatter_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    (void)net;
+    (void)data;
+    (void)len;
+    if (from_b) return 0;
+    return (int)((index * 2654435761u) >> 7) % 8000;
+}
+
+static int check_reassembly() {
+    CheckNet net;
+    check_net_init(&net, 4);
+    net.filter = check_scatter_filter;
+    net.msg = 5000;
+
+    net.tx = check_payload(500 * 5000, 4);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.b, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(net.rx_msgs == 500);
+    CHECK(stats.rcv_buf_len == 0);
+    CHECK(stats.rcv_queue_len == 0);
+    return 0;
+}
+
+struct CheckCompact {
+    uint64_t compact;
+    uint64_t full;
+    uint64_t misfit;
+};
+
+static int check_compact_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    CheckCompact *cc = (CheckCompact*)net->arg;
+    if (from_b) return 0;
+    if (len > 4 && ((uint8_t)data[4] & DCP_HDR_COMPACT)) {
+        cc->compact++;
+        if ((data[4] & DCP_HDR_CMD_MASK) == (DCP_CMD_PUSH & DCP_HDR_CMD_MASK) && len != DCP_OVERHEAD_MIN + net->msg) {
+            cc->misfit++;
+        }
+    } else {
+        cc->full++;
+    }
+    return (index % 20 == 10) ? -1 : 0;
+}
+
+static int check_compact_header() {
+    CheckNet net;
+    CheckCompact cc = {0, 0, 0};
+    check_net_init(&net, 5);
+    net.filter = check_compact_filter;
+    net.arg = &cc;
+    dcp_set_compact_header(net.a, 1);
+    dcp_set_compact_header(net.b, 1);
+    net.a->snd_una = net.a->snd_nxt = 0xFFFFFF00u;
+    net.b->rcv_nxt = 0xFFFFFF00u;
+
+    net.tx = check_payload(512 * 1000, 5);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(cc.compact > cc.full);
+    CHECK(cc.misfit == 0);
+    CHECK(stats.segs_retrans == net.dropped[0]);
+    return 0;
+}
+
+static int check_stream_coalesce() {
+    CheckNet net;
+    check_net_init(&net, 6);
+    dcp_wndsize(net.a, 128, 128);
+    dcp_wndsize(net.b, 128, 128);
+    dcp_set_stream(net.a, 1, 5);
+    dcp_set_stream(net.b, 1, 5);
+    net.msg = 100;
+
+    uint32_t mss = net.a->mss;
+    net.tx = check_payload(100 * mss + mss / 2, 6);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(stats.segs_retrans == 0);
+    CHECK(stats.segs_sent == (net.tx.size() + mss - 1) / mss);
+    return 0;
+}
+
+struct CheckFecLoss {
+    uint32_t patterns[36];
+    std::set<uint32_t> seen;
+    uint64_t lost;
+};
+
+static int check_fec_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    CheckFecLoss *fl = (CheckFecLoss*)net->arg;
+    (void)index;
+    if (from_b || len < DCP_OVERHEAD || (uint8_t)data[7] != DCP_CMD_PUSH) return 0;
+
+    uint32_t sn = ((uint32_t)(uint8_t)data[20] << 24) | ((uint32_t)(uint8_t)data[21] << 16) |
+                  ((uint32_t)(uint8_t)data[22] << 8) | (uint32_t)(uint8_t)data[23];
+    if (!fl->seen.insert(sn).second) return 0;
+    if ((fl->patterns[(sn / 8) % 36] >> (sn % 8)) & 1) {
+        fl->lost++;
+        return -1;
+    }
+    return 0;
+}
+
+static int check_fec_recovery() {
+    CheckNet net;
+    CheckFecLoss fl;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        fl.patterns[n++] = 1u << i;
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+        for (uint32_t j = i + 1; j < 8; j++) fl.patterns[n++] = (1u << i) | (1u << j);
+    }
+    fl.lost = 0;
+
+    check_net_init(&net, 7);
+    net.filter = check_fec_filter;
+    net.arg = &fl;
+    dcp_wndsize(net.a, 512, 512);
+    dcp_wndsize(net.b, 512, 512);
+    dcp_set_fec(net.a, 8, 2);
+    dcp_set_fec(net.b, 8, 0);
+
+    net.tx = check_payload(36 * 8 * 1000, 7);
+    check_net_run(&net, 10000000);
+
+    DCPStats sa, sb;
+    dcp_get_stats(net.a, &sa);
+    dcp_get_stats(net.b, &sb);
+    CHECK(net.rx == net.tx);
+    CHECK(fl.lost == 8 + 28 * 2);
+    CHECK(sa.segs_retrans == 0);
+    CHECK(sa.rto_timeouts == 0);
+    CHECK(sb.fec_recovered == fl.lost);
+    return 0;
+}
+
+static int check_clock_start() {
+    CheckNet net;
+    check_net_init(&net, 8);
+    net.now_us = 1ULL << 40;
+
+    net.tx = check_payload(256 * 1024, 8);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(stats.segs_retrans == 0);
+    CHECK(stats.rto_timeouts == 0);
+    return 0;
+}
+
+static int check_clock_wrap() {
+    CheckNet net;
+    check_net_init(&net, 10);
+    net.now_us = (0x100000000ULL - 500) * 1000;
+
+    net.tx = check_payload(1024 * 1024, 10);
+    check_net_run(&net, 10000000);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(net.rx == net.tx);
+    CHECK(net.now_us / 1000 > 0x100000000ULL);
+    CHECK(stats.segs_retrans == 0);
+    CHECK(net.a->rx_srtt >= 20 && net.a->rx_srtt < 100);
+    return 0;
+}
+
+static int check_blackhole_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    (void)net;
+    (void)index;
+    (void)data;
+    (void)len;
+    return from_b ? 0 : -1;
+}
+
+static int check_clock_stall() {
+    CheckNet net;
+    check_net_init(&net, 9);
+    net.filter = check_blackhole_filter;
+    net.now_us = 1ULL << 40;
+
+    net.tx = check_payload(8 * 1000, 9);
+    check_net_service(&net);
+    for (int i = 0; i < 50; i++) {
+        dcp_scheduler_run_us(net.scheduler, net.now_us);
+        net.now_us += 1000;
+    }
+    uint64_t sent = net.sent[0];
+
+    net.now_us += 10000000;
+    dcp_scheduler_run_us(net.scheduler, net.now_us);
+
+    DCPStats stats;
+    dcp_get_stats(net.a, &stats);
+    CHECK(sent == 8);
+    CHECK(stats.rto_timeouts == 1);
+    CHECK(net.sent[0] - sent <= 2 * sent);
+    return 0;
+}
+
+static int check_xmit_log_filter(CheckNet *net, int from_b, uint64_t index, const char *data, int len) {
+    std::vector<uint64_t> *log = (std::vector<uint64_t>*)net->arg;
+    (void)index;
+    (void)data;
+    (void)len;
+    if (from_b) return 0;
+    log->push_back(net->now_us);
+    return -1;
+}
+
+static int check_rto_deadline() {
+    CheckNet net;
+    std::vector<uint64_t> xmits;
+    check_net_init(&net, 13);
+    net.filter = check_xmit_log_filter;
+    net.arg = &xmits;
+
+    std::string msg = check_payload(1000, 13);
+    for (net.now_us = 1000; net.now_us <= 700000; net.now_us += 1000) {
+        uint32_t now_ms = (uint32_t)(net.now_us / 1000);
+        if (now_ms == 1 || now_ms == 250) dcp_send(net.a, msg.data(), (int)msg.size(), now_ms);
+        dcp_scheduler_run_us(net.scheduler, net.now_us);
+    }
+
+    CHECK(xmits.size() >= 4);
+    CHECK(xmits[0] == 1000);
+    CHECK(xmits[1] >= 201000 && xmits[1] <= 202000);
+    CHECK(xmits[2] == 250000);
+    CHECK(xmits[3] >= 450000 && xmits[3] <= 451000);
+    return 0;
+}
+
+#define CHECK_RT_THREADS 4
+#define CHECK_RT_CONVS   16
+#define CHECK_RT_MSGS    250
+
+struct CheckRtConv {
+    DCPCB *a;
+    DCPCB *b;
+    uint32_t next[CHECK_RT_THREADS];
+    int bad;
+};
+
+static std::atomic<uint64_t> g_rt_delivered;
+static std::atomic<int> g_rt_closing;
+
+struct CheckRtPacket {
+    DCPTask task;
+    DCPCB *to;
+    CheckRtConv *conv;
+    int len;
+    char data[1];
+};
+
+static void check_rt_packet_run(DCPScheduler *scheduler, DCPTask *task, uint32_t now) {
+    CheckRtPacket *pkt = (CheckRtPacket*)task;
+    CheckRtConv *conv = pkt->conv;
+    uint32_t msg[2];
+    (void)scheduler;
+
+    if (!g_rt_closing.load()) {
+        dcp_input(pkt->to, pkt->data, pkt->len, now);
+        while (pkt->to == conv->b && dcp_recv(conv->b, (char*)msg, sizeof(msg)) == (int)sizeof(msg)) {
+            if (msg[0] >= CHECK_RT_THREADS || msg[1] != conv->next[msg[0]]++) conv->bad++;
+            g_rt_delivered++;
+        }
+    }
+    free(pkt);
+}
+
+static int check_rt_output(const char *buffer, int len, DCPCB *dcp, void *user) {
+    CheckRtConv *conv = (CheckRtConv*)user;
+    if (g_rt_closing.load()) return 0;
+
+    CheckRtPacket *pkt = (CheckRtPacket*)malloc(sizeof(CheckRtPacket) + len);
+    pkt->task.run = check_rt_packet_run;
+    pkt->to = (dcp == conv->a) ? conv->b : conv->a;
+    pkt->conv = conv;
+    pkt->len = len;
+    memcpy(pkt->data, buffer, len);
+    dcp_scheduler_post(dcp->scheduler, &pkt->task);
+    return 0;
+}
+
+static int check_runtime_run(uint32_t wnd, uint64_t *deferred) {
+    DCPRuntime *rt = dcp_runtime_create(4);
+    CheckRtConv convs[CHECK_RT_CONVS];
+    CHECK(rt != NULL);
+
+    g_rt_delivered = 0;
+    g_rt_closing = 0;
+    for (uint32_t c = 0; c < CHECK_RT_CONVS; c++) {
+        CheckRtConv *conv = &convs[c];
+        DCPShard *shard = dcp_runtime_shard(rt, c + 1);
+        memset(conv, 0, sizeof(*conv));
+        conv->a = dcp_create(c + 1, 0, conv, shard->scheduler);
+        conv->b = dcp_create(c + 1, 0, conv, shard->scheduler);
+        dcp_set_output(conv->a, check_rt_output);
+        dcp_set_output(conv->b, check_rt_output);
+        if (wnd > 0) {
+            dcp_wndsize(conv->a, wnd, wnd);
+            dcp_wndsize(conv->b, wnd, wnd);
+        }
+        dcp_endpoint_add(shard->endpoint, conv->a);
+    }
+    dcp_runtime_start(rt, NULL, NULL);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> send_errors(0);
+    for (uint32_t t = 0; t < CHECK_RT_THREADS; t++) {
+        threads.emplace_back([rt, t, &send_errors] {
+            for (uint32_t i = 0; i < CHECK_RT_MSGS; i++) {
+                for (uint32_t c = 0; c < CHECK_RT_CONVS; c++) {
+                    uint32_t msg[2] = {t, i};
+                    if (dcp_runtime_send(rt, c + 1, (const char*)msg, sizeof(msg)) != 0) send_errors++;
+                }
+            }
+        });
+    }
+    for (std::thread &th : threads) th.join();
+
+    uint64_t expected = (uint64_t)CHECK_RT_THREADS * CHECK_RT_MSGS * CHECK_RT_CONVS;
+    for (int i = 0; i < 5000 && g_rt_delivered.load() < expected; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    dcp_runtime_stop(rt);
+
+    g_rt_closing = 1;
+    uint64_t posted = 0, dropped = 0;
+    for (int i = 0; i < rt->shard_count; i++) {
+        dcp_scheduler_run_us(rt->shards[i].scheduler, dcp_runtime_now_us());
+        posted += rt->shards[i].posted;
+        dropped += rt->shards[i].send_dropped;
+        *deferred += rt->shards[i].send_deferred;
+    }
+    int bad = 0;
+    for (uint32_t c = 0; c < CHECK_RT_CONVS; c++) {
+        bad += convs[c].bad;
+        dcp_release(convs[c].a);
+        dcp_release(convs[c].b);
+    }
+    dcp_runtime_release(rt);
+
+    CHECK(send_errors.load() == 0);
+    CHECK(posted == expected);
+    CHECK(dropped == 0);
+    CHECK(bad == 0);
+    CHECK(g_rt_delivered.load() == expected);
+    return 0;
+}
+
+static int check_runtime_post() {
+    uint64_t deferred = 0;
+    return check_runtime_run(4096, &deferred);
+}
+
+static int check_runtime_backpressure() {
+    uint64_t deferred = 0;
+    int ret = check_runtime_run(0, &deferred);
+    if (ret != 0) return ret;
+    CHECK(deferred > 0);
+    return 0;
+}
+
+struct CheckEcho {
+    DCPScheduler *scheduler = nullptr;
+    DCPEndpoint *ea = nullptr;
+    DCPEndpoint *eb = nullptr;
+    DCPCB *a = nullptr;
+    DCPCB *b = nullptr;
+    struct sockaddr_in addr_a;
+    struct sockaddr_in addr_b;
+    std::string tx;
+    size_t tx_off = 0;
+    std::string pending;
+    std::string rx;
+
+    void detach() {
+        dcp_release(a);
+        dcp_release(b);
+        a = b = nullptr;
+    }
+
+    ~CheckEcho() {
+        detach();
+        dcp_endpoint_release(ea);
+        dcp_endpoint_release(eb);
+        dcp_scheduler_release(scheduler);
+    }
+};
+
+static void check_loopback_addr(struct sockaddr_in *addr) {
+    socklen_t len = sizeof(*addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0) return;
+    if (bind(fd, (struct sockaddr*)addr, sizeof(*addr)) == 0) {
+        getsockname(fd, (struct sockaddr*)addr, &len);
+    }
+    close(fd);
+}
+
+static void check_echo_init(CheckEcho *e, uint32_t conv) {
+    e->scheduler = dcp_scheduler_create();
+    e->ea = dcp_endpoint_create(nullptr);
+    e->eb = dcp_endpoint_create(nullptr);
+    e->a = dcp_create(conv, 1, nullptr, e->scheduler);
+    e->b = dcp_create(conv, 1, nullptr, e->scheduler);
+    dcp_wndsize(e->a, 256, 256);
+    dcp_wndsize(e->b, 256, 256);
+    check_loopback_addr(&e->addr_a);
+    check_loopback_addr(&e->addr_b);
+    e->tx = check_payload(1024 * 1024, conv);
+}
+
+static int check_echo_service(CheckEcho *e) {
+    static char buf[65536];
+    uint32_t now_ms = (uint32_t)(dcp_runtime_now_us() / 1000);
+    int n;
+
+    while (e->tx_off < e->tx.size()) {
+        size_t len = e->tx.size() - e->tx_off;
+        if (len > 1000) len = 1000;
+        if (dcp_send(e->a, e->tx.data() + e->tx_off, (int)len, now_ms) != 0) break;
+        e->tx_off += len;
+    }
+
+    if (!e->pending.empty() && dcp_send(e->b, e->pending.data(), (int)e->pending.size(), now_ms) == 0) {
+        e->pending.clear();
+    }
+    while (e->pending.empty() && (n = dcp_recv(e->b, buf, sizeof(buf))) > 0) {
+        if (dcp_send(e->b, buf, n, now_ms) != 0) e->pending.assign(buf, n);
+    }
+
+    while ((n = dcp_recv(e->a, buf, sizeof(buf))) > 0) {
+        e->rx.append(buf, n);
+    }
+    return e->rx.size() >= e->tx.size();
+}
+
+static int check_udp_echo() {
+    CheckEcho e;
+    check_echo_init(&e, 11);
+
+    DCPUdp *ua = dcp_udp_open(e.ea, (struct sockaddr*)&e.addr_a, sizeof(e.addr_a), DCP_UDP_GSO | DCP_UDP_GRO);
+    DCPUdp *ub = dcp_udp_open(e.eb, (struct sockaddr*)&e.addr_b, sizeof(e.addr_b), DCP_UDP_GSO | DCP_UDP_GRO);
+    int attached = ua != nullptr && ub != nullptr &&
+                   dcp_udp_attach(ua, e.a, (struct sockaddr*)&e.addr_b, sizeof(e.addr_b)) == 0 &&
+                   dcp_udp_attach(ub, e.b, (struct sockaddr*)&e.addr_a, sizeof(e.addr_a)) == 0;
+
+    check_echo_service(&e);
+    size_t queued = e.tx_off;
+
+    uint64_t start_us = dcp_runtime_now_us();
+    while (attached && !check_echo_service(&e) && dcp_runtime_now_us() - start_us < 10000000) {
+        uint64_t now_us = dcp_runtime_now_us();
+        dcp_scheduler_run_us(e.scheduler, now_us);
+        dcp_udp_recv(ub, (uint32_t)(now_us / 1000), 4);
+        dcp_udp_recv(ua, (uint32_t)(now_us / 1000), 4);
+        dcp_scheduler_run_us(e.scheduler, now_us);
+    }
+
+    DCPUdpStats stats;
+    DCPStats sa;
+    memset(&stats, 0, sizeof(stats));
+    dcp_udp_get_stats(ua, &stats);
+    dcp_get_stats(e.a, &sa);
+    e.detach();
+    dcp_udp_close(ua);
+    dcp_udp_close(ub);
+
+    CHECK(attached);
+    CHECK(queued > 0);
+    CHECK(e.rx == e.tx);
+    CHECK(stats.tx_errors == 0);
+    CHECK(sa.rto_timeouts == 0);
+    return 0;
+}
+
+static int check_uring_echo() {
+    CheckEcho e;
+    check_echo_init(&e, 12);
+
+    DCPUring *ua = dcp_uring_open(e.ea, e.scheduler, (struct sockaddr*)&e.addr_a, sizeof(e.addr_a));
+    DCPUring *ub = dcp_uring_open(e.eb, e.scheduler, (struct sockaddr*)&e.addr_b, sizeof(e.addr_b));
+    if (ua == nullptr || ub == nullptr) {
+        e.detach();
+        dcp_uring_close(ua);
+        dcp_uring_close(ub);
+        return CHECK_SKIP;
+    }
+    int attached = dcp_uring_attach(ua, e.a, (struct sockaddr*)&e.addr_b, sizeof(e.addr_b)) == 0 &&
+                   dcp_uring_attach(ub, e.b, (struct sockaddr*)&e.addr_a, sizeof(e.addr_a)) == 0;
+
+    uint64_t start_us = dcp_runtime_now_us();
+    while (attached && !check_echo_service(&e) && dcp_runtime_now_us() - start_us < 10000000) {
+        uint64_t now_us = dcp_runtime_now_us();
+        dcp_uring_tick(ua, now_us, 0);
+        dcp_uring_tick(ub, now_us, 0);
+    }
+
+    DCPUringStats sa, sb;
+    dcp_uring_get_stats(ua, &sa);
+    dcp_uring_get_stats(ub, &sb);
+    e.detach();
+    dcp_uring_close(ua);
+    dcp_uring_close(ub);
+
+    CHECK(attached);
+    CHECK(e.rx == e.tx);
+    CHECK(sa.tx_errors == 0 && sb.tx_errors == 0);
+    CHECK(sa.tx_dropped == 0 && sb.tx_dropped == 0);
+    return 0;
+}
+
+static void check_loop_readable(DCPLoop *loop, DCPLoopWatch *watch, uint32_t events, uint64_t now_us) {
+    (void)loop;
+    (void)events;
+    dcp_udp_recv((DCPUdp*)watch->arg, (uint32_t)(now_us / 1000), 4);
+}
+
+static int check_loop_echo() {
+    CheckEcho e;
+    check_echo_init(&e, 13);
+
+    DCPLoop *loop = dcp_loop_create(e.scheduler);
+    DCPUdp *ua = dcp_udp_open(e.ea, (struct sockaddr*)&e.addr_a, sizeof(e.addr_a), 0);
+    DCPUdp *ub = dcp_udp_open(e.eb, (struct sockaddr*)&e.addr_b, sizeof(e.addr_b), 0);
+    DCPLoopWatch wa = {dcp_udp_fd(ua), check_loop_readable, ua};
+    DCPLoopWatch wb = {dcp_udp_fd(ub), check_loop_readable, ub};
+    int attached = loop != nullptr && ua != nullptr && ub != nullptr &&
+                   dcp_udp_attach(ua, e.a, (struct sockaddr*)&e.addr_b, sizeof(e.addr_b)) == 0 &&
+                   dcp_udp_attach(ub, e.b, (struct sockaddr*)&e.addr_a, sizeof(e.addr_a)) == 0 &&
+                   dcp_loop_add(loop, &wa, EPOLLIN) == 0 &&
+                   dcp_loop_add(loop, &wb, EPOLLIN) == 0;
+
+    uint64_t start_us = dcp_runtime_now_us();
+    while (attached && !check_echo_service(&e) && dcp_runtime_now_us() - start_us < 10000000) {
+        if (dcp_loop_run_once(loop, 10) < 0) break;
+    }
+
+    uint64_t timer_fires = (loop != nullptr) ? loop->timer_fires : 0;
+    e.detach();
+    dcp_loop_release(loop);
+    dcp_udp_close(ua);
+    dcp_udp_close(ub);
+
+    CHECK(attached);
+    CHECK(e.rx == e.tx);
+    CHECK(timer_fires > 0);
+    return 0;
+}
+
+struct CheckCase {
+    const char *name;
+    int (*run)();
+};
+
+static const CheckCase g_cases[] = {
+    {"clean_link", check_clean_link},
+    {"reorder_only", check_reorder_only},
+    {"sack_wrap", check_sack_wrap},
+    {"reassembly", check_reassembly},
+    {"compact_header", check_compact_header},
+    {"stream_coalesce", check_stream_coalesce},
+    {"fec_recovery", check_fec_recovery},
+    {"clock_start", check_clock_start},
+    {"clock_stall", check_clock_stall},
+    {"clock_wrap", check_clock_wrap},
+    {"rto_deadline", check_rto_deadline},
+    {"runtime_post", check_runtime_post},
+    {"runtime_backpressure", check_runtime_backpressure},
+    {"udp_echo", check_udp_echo},
+    {"uring_echo", check_uring_echo},
+    {"loop_echo", check_loop_echo},
+};
+
+int main(int argc, char **argv) {
+    int passed = 0, failed = 0, skipped = 0;
+
+    if (argc > 1) g_filter = argv[1];
+
+    for (const CheckCase &c : g_cases) {
+        if (g_filter != nullptr && strstr(c.name, g_filter) == nullptr) continue;
+
+        int ret = c.run();
+        printf("%-32s %s\n", c.name, ret == 0 ? "ok" : (ret == CHECK_SKIP ? "skipped" : "FAILED"));
+        if (ret == 0) passed++;
+        else if (ret == CHECK_SKIP) skipped++;
+        else failed++;
+    }
+
+    printf("%d passed, %d failed, %d skipped\n", passed, failed, skipped);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+#include <cstdio>
+#include <cstdint>
+#include <cinttypes>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include "dcp_trace.h"
+}
+
+static const char* qlog_cc_state(uint32_t state) {
+    static const char *names[] = { "startup", "drain", "probe_bw", "probe_rtt" };
+    return (state < 4) ? names[state] : "unknown";
+}
+
+static const char* qlog_reason(uint32_t reason) {
+    switch (reason) {
+        case DCP_TRACE_REASON_FASTACK: return "reordering_threshold";
+        case DCP_TRACE_REASON_RACK: return "time_threshold";
+        case DCP_TRACE_REASON_RTO: return "retransmit_timeout";
+        case DCP_TRACE_REASON_TLP: return "pto_probe";
+        default: return "unknown";
+    }
+}
+
+static const char* qlog_recv_status(uint32_t status) {
+    switch (status) {
+        case DCP_TRACE_RECV_DUP: return "duplicate";
+        case DCP_TRACE_RECV_WINDOW: return "out_of_window";
+        default: return "accepted";
+    }
+}
+
+static void qlog_event(FILE *out, const DCPTraceEvent &ev, uint64_t ref_us, bool first) {
+    fprintf(out, "%s\n        {\"time\": %.3f, ", first ? "" : ",", (double)(ev.time_us - ref_us) / 1000.0);
+
+    switch (ev.type) {
+        case DCP_TRACE_PKT_SENT:
+            fprintf(out, "\"name\": \"transport:packet_sent\", \"data\": {\"header\": {\"packet_number\": %u}, "
+                    "\"raw\": {\"payload_length\": %u}, \"bytes_in_flight\": %" PRIu64 "}}",
+                    ev.a, ev.b, ev.c);
+            break;
+        case DCP_TRACE_PKT_RETRANS:
+            fprintf(out, "\"name\": \"transport:packet_sent\", \"data\": {\"header\": {\"packet_number\": %u}, "
+                    "\"raw\": {\"payload_length\": %u}, \"bytes_in_flight\": %" PRIu64 ", \"trigger\": \"%s\"}}",
+                    ev.a, ev.b, ev.c, qlog_reason(ev.flags));
+            break;
+        case DCP_TRACE_PKT_RECV:
+            if (ev.flags == DCP_TRACE_RECV_OK) {
+                fprintf(out, "\"name\": \"transport:packet_received\", \"data\": {\"header\": {\"packet_number\": %u}, "
+                        "\"raw\": {\"payload_length\": %u}}}", ev.a, ev.b);
+            } else {
+                fprintf(out, "\"name\": \"transport:packet_dropped\", \"data\": {\"header\": {\"packet_number\": %u}, "
+                        "\"raw\": {\"payload_length\": %u}, \"trigger\": \"%s\", \"rcv_nxt\": %" PRIu64 "}}",
+                        ev.a, ev.b, qlog_recv_status(ev.flags), ev.c);
+            }
+            break;
+        case DCP_TRACE_PKT_ACKED:
+        case DCP_TRACE_PKT_SACKED:
+            fprintf(out, "\"name\": \"dcp:packet_acked\", \"data\": {\"packet_number\": %u, \"rtt\": %u, "
+                    "\"sack\": %s, \"bytes_in_flight\": %" PRIu64 "}}",
+                    ev.a, ev.b, (ev.type == DCP_TRACE_PKT_SACKED) ? "true" : "false", ev.c);
+            break;
+        case DCP_TRACE_PKT_LOST:
+            fprintf(out, "\"name\": \"recovery:packet_lost\", \"data\": {\"header\": {\"packet_number\": %u}, "
+                    "\"transmissions\": %u, \"trigger\": \"%s\"}}", ev.a, ev.b, qlog_reason(ev.flags));
+            break;
+        case DCP_TRACE_RTO:
+            fprintf(out, "\"name\": \"recovery:loss_timer_updated\", \"data\": {\"timer_type\": \"rto\", "
+                    "\"event_type\": \"expired\", \"first_lost\": %u, \"lost\": %u, \"rto\": %" PRIu64 "}}",
+                    ev.a, ev.b, ev.c);
+            break;
+        case DCP_TRACE_TLP:
+            fprintf(out, "\"name\": \"recovery:loss_timer_updated\", \"data\": {\"timer_type\": \"pto\", "
+                    "\"event_type\": \"expired\", \"snd_una\": %u, \"snd_nxt\": %u}}", ev.a, ev.b);
+            break;
+        case DCP_TRACE_PACING:
+            fprintf(out, "\"name\": \"recovery:metrics_updated\", \"data\": {\"pacing_rate\": %" PRIu64 ", "
+                    "\"pacing_delay_us\": %u, \"burst\": %u}}", ev.c * 8, ev.a, ev.b);
+            break;
+        case DCP_TRACE_CC_STATE:
+            fprintf(out, "\"name\": \"recovery:congestion_state_updated\", \"data\": {\"old\": \"%s\", "
+                    "\"new\": \"%s\", \"btl_bw\": %" PRIu64 "}}",
+                    qlog_cc_state(ev.a), qlog_cc_state(ev.b), ev.c * 8);
+            break;
+        case DCP_TRACE_METRICS:
+            fprintf(out, "\"name\": \"recovery:metrics_updated\", \"data\": {\"congestion_window\": %u, "
+                    "\"smoothed_rtt\": %u, \"pacing_rate\": %" PRIu64 "}}", ev.a, ev.b, ev.c * 8);
+            break;
+        case DCP_TRACE_TIMER_TICK:
+            fprintf(out, "\"name\": \"dcp:timer_tick\", \"data\": {\"tick\": %" PRIu64 ", \"fired\": %u, "
+                    "\"lateness_us\": %u}}", ev.c, ev.a, ev.b);
+            break;
+        default:
+            fprintf(out, "\"name\": \"dcp:unknown\", \"data\": {\"type\": %u}}", ev.type);
+            break;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s trace.bin [out.qlog]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == nullptr) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    DCPTraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != DCP_TRACE_FILE_MAGIC ||
+        header.version != DCP_TRACE_FILE_VERSION || header.event_size != sizeof(DCPTraceEvent)) {
+        fprintf(stderr, "%s is not a DCP trace\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+
+    std::map<uint32_t, std::vector<DCPTraceEvent> > conns;
+    std::vector<DCPTraceEvent> scheduler;
+    uint64_t ref_us = UINT64_MAX;
+    DCPTraceEvent ev;
+    while (fread(&ev, sizeof(ev), 1, in) == 1) {
+        if (ev.time_us < ref_us) ref_us = ev.time_us;
+        if (ev.type == DCP_TRACE_TIMER_TICK) {
+            scheduler.push_back(ev);
+        } else {
+            conns[ev.conv_id].push_back(ev);
+        }
+    }
+    fclose(in);
+    if (ref_us == UINT64_MAX) ref_us = 0;
+
+    FILE *out = (argc > 2) ? fopen(argv[2], "w") : stdout;
+    if (out == nullptr) {
+        fprintf(stderr, "cannot open %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "{\"qlog_version\": \"0.3\", \"qlog_format\": \"JSON\", \"title\": \"dcp trace\", \"traces\": [");
+
+    bool first_trace = true;
+    for (auto &it : conns) {
+        fprintf(out, "%s\n  {\"title\": \"conv %u\", \"vantage_point\": {\"type\": \"client\"}, "
+                "\"common_fields\": {\"group_id\": \"%u\", \"time_format\": \"relative\", "
+                "\"reference_time\": %.3f}, \"events\": [",
+                first_trace ? "" : ",", it.first, it.first, (double)ref_us / 1000.0);
+        for (size_t i = 0; i < it.second.size(); i++) {
+            qlog_event(out, it.second[i], ref_us, i == 0);
+        }
+        fprintf(out, "\n  ]}");
+        first_trace = false;
+    }
+    if (!scheduler.empty()) {
+        fprintf(out, "%s\n  {\"title\": \"scheduler\", \"vantage_point\": {\"type\": \"unknown\"}, "
+                "\"common_fields\": {\"time_format\": \"relative\", \"reference_time\": %.3f}, \"events\": [",
+                first_trace ? "" : ",", (double)ref_us / 1000.0);
+        for (size_t i = 0; i < scheduler.size(); i++) {
+            qlog_event(out, scheduler[i], ref_us, i == 0);
+        }
+        fprintf(out, "\n  ]}");
+    }
+    fprintf(out, "\n]}\n");
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
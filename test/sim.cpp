@@ -0,0 +1,456 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+#include "dcp_allocator.h"
+#include "dcp_scheduler.h"
+#include "dcp_trace.h"
+#include "dcp.h"
+}
+
+struct SimConfig {
+    int pairs = 8;
+    double bw_mbps = 100.0;
+    uint32_t rtt_ms = 40;
+    uint32_t jitter_ms = 0;
+    uint32_t queue_pkts = 256;
+    double loss = 0.0;
+    double ge_p = 0.0;
+    double ge_r = 0.3;
+    double ge_h = 0.5;
+    double reorder = 0.0;
+    uint32_t reorder_ms = 5;
+    int msg_size = 1200;
+    double rate = 0.0;
+    double duration = 10.0;
+    uint64_t seed = 1;
+    int mtu = DCP_MTU_DEF;
+    int wnd = 1024;
+    std::string trace;
+    int stream = 0;
+    int cork_ms = 0;
+    int fec_k = 0;
+    int fec_m = 0;
+    double max_drop = -1.0;
+};
+
+struct SimRng {
+    uint64_t s;
+
+    explicit SimRng(uint64_t seed) : s(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    uint64_t next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 0x2545F4914F6CDD1DULL;
+    }
+
+    double uniform() {
+        return (double)(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+struct SimPair;
+
+struct SimEvent {
+    uint64_t at_us;
+    uint64_t order;
+    SimPair *pair;
+    int to_b;
+    std::string data;
+};
+
+struct SimEventLater {
+    bool operator()(const SimEvent *a, const SimEvent *b) const {
+        return (a->at_us != b->at_us) ? a->at_us > b->at_us : a->order > b->order;
+    }
+};
+
+struct SimLink {
+    uint64_t free_us = 0;
+    int ge_bad = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t lost = 0;
+    uint64_t dropped = 0;
+};
+
+struct SimPair {
+    int index;
+    DCPCB *a;
+    DCPCB *b;
+    uint32_t next_seq = 0;
+    uint64_t next_msg_us = 0;
+    uint64_t delivered_bytes = 0;
+    uint64_t delivered_msgs = 0;
+    uint64_t a_packets = 0;
+    int dirty = 0;
+    std::string rx;
+};
+
+struct SimEndpoint {
+    SimPair *pair;
+    int is_b;
+};
+
+static SimConfig g_cfg;
+static SimRng g_rng(1);
+static uint64_t g_now_us;
+static uint64_t g_order;
+static SimLink g_link[2];
+static std::priority_queue<SimEvent*, std::vector<SimEvent*>, SimEventLater> g_events;
+static std::vector<SimPair*> g_dirty;
+static std::vector<uint32_t> g_latency_us;
+
+static void sim_mark_dirty(SimPair *pair) {
+    if (!pair->dirty) {
+        pair->dirty = 1;
+        g_dirty.push_back(pair);
+    }
+}
+
+static int sim_link_loses(SimLink *link) {
+    if (g_cfg.ge_p > 0.0) {
+        if (link->ge_bad) {
+            if (g_rng.uniform() < g_cfg.ge_r) link->ge_bad = 0;
+        } else {
+            if (g_rng.uniform() < g_cfg.ge_p) link->ge_bad = 1;
+        }
+        if (link->ge_bad && g_rng.uniform() < g_cfg.ge_h) return 1;
+    }
+    return g_cfg.loss > 0.0 && g_rng.uniform() < g_cfg.loss;
+}
+
+static int sim_output(const char *buffer, int len, DCPCB *dcp, void *user) {
+    SimEndpoint *ep = (SimEndpoint*)user;
+    SimLink *link = &g_link[ep->is_b];
+    (void)dcp;
+
+    link->packets++;
+    link->bytes += len;
+    if (!ep->is_b) ep->pair->a_packets++;
+
+    double bytes_per_us = g_cfg.bw_mbps / 8.0;
+    uint64_t start = (link->free_us > g_now_us) ? link->free_us : g_now_us;
+    double backlog = (double)(start - g_now_us) * bytes_per_us;
+    if (backlog + len > (double)g_cfg.queue_pkts * g_cfg.mtu) {
+        link->dropped++;
+        return 0;
+    }
+    link->free_us = start + (uint64_t)ceil(len / bytes_per_us);
+
+    if (sim_link_loses(link)) {
+        link->lost++;
+        return 0;
+    }
+
+    uint64_t at = link->free_us + (uint64_t)g_cfg.rtt_ms * 500;
+    if (g_cfg.jitter_ms > 0) {
+        at += g_rng.next() % ((uint64_t)g_cfg.jitter_ms * 1000 + 1);
+    }
+    if (g_cfg.reorder > 0.0 && g_rng.uniform() < g_cfg.reorder) {
+        at += (uint64_t)g_cfg.reorder_ms * 1000;
+    }
+
+    SimEvent *ev = new SimEvent;
+    ev->at_us = at;
+    ev->order = g_order++;
+    ev->pair = ep->pair;
+    ev->to_b = !ep->is_b;
+    ev->data.assign(buffer, len);
+    g_events.push(ev);
+    return 0;
+}
+
+static int sim_send_message(SimPair *pair) {
+    std::vector<char> msg(g_cfg.msg_size, (char)pair->index);
+    uint64_t ts = g_now_us;
+    uint32_t seq = pair->next_seq;
+
+    memcpy(msg.data(), &ts, sizeof(ts));
+    memcpy(msg.data() + sizeof(ts), &seq, sizeof(seq));
+    if (dcp_send(pair->a, msg.data(), g_cfg.msg_size, (uint32_t)(g_now_us / 1000)) != 0) {
+        return -1;
+    }
+    pair->next_seq++;
+    return 0;
+}
+
+static void sim_deliver(SimPair *pair, const char *msg, int len) {
+    uint64_t ts;
+    memcpy(&ts, msg, sizeof(ts));
+    g_latency_us.push_back((uint32_t)(g_now_us - ts));
+    pair->delivered_bytes += len;
+    pair->delivered_msgs++;
+}
+
+static void sim_service(SimPair *pair) {
+    std::vector<char> buf(g_cfg.msg_size);
+    int n;
+
+    while ((n = dcp_recv(pair->b, buf.data(), (int)buf.size())) > 0) {
+        if (!g_cfg.stream) {
+            sim_deliver(pair, buf.data(), n);
+            continue;
+        }
+        pair->rx.append(buf.data(), n);
+        if (pair->rx.size() >= (size_t)g_cfg.msg_size) {
+            sim_deliver(pair, pair->rx.data(), g_cfg.msg_size);
+            pair->rx.erase(0, g_cfg.msg_size);
+        }
+    }
+
+    if (g_cfg.rate > 0.0) {
+        uint64_t gap = (uint64_t)(1e6 / g_cfg.rate);
+        while (pair->next_msg_us <= g_now_us) {
+            sim_send_message(pair);
+            pair->next_msg_us += gap;
+        }
+    } else {
+        uint32_t limit = (uint32_t)g_cfg.wnd * 2;
+        while (pair->a->snd_queue_len + pair->a->snd_buf_len < limit) {
+            if (sim_send_message(pair) != 0) break;
+        }
+    }
+}
+
+static void sim_parse(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *eq = strchr(argv[i], '=');
+        if (eq == NULL) {
+            fprintf(stderr, "ignoring argument '%s' (expected key=value)\n", argv[i]);
+            continue;
+        }
+        std::string key(argv[i], eq - argv[i]);
+        const char *v = eq + 1;
+
+        if (key == "pairs") g_cfg.pairs = atoi(v);
+        else if (key == "bw") g_cfg.bw_mbps = atof(v);
+        else if (key == "rtt") g_cfg.rtt_ms = (uint32_t)atoi(v);
+        else if (key == "jitter") g_cfg.jitter_ms = (uint32_t)atoi(v);
+        else if (key == "queue") g_cfg.queue_pkts = (uint32_t)atoi(v);
+        else if (key == "loss") g_cfg.loss = atof(v);
+        else if (key == "ge") sscanf(v, "%lf,%lf,%lf", &g_cfg.ge_p, &g_cfg.ge_r, &g_cfg.ge_h);
+        else if (key == "reorder") g_cfg.reorder = atof(v);
+        else if (key == "reorder_ms") g_cfg.reorder_ms = (uint32_t)atoi(v);
+        else if (key == "msg") g_cfg.msg_size = atoi(v);
+        else if (key == "rate") g_cfg.rate = atof(v);
+        else if (key == "duration") g_cfg.duration = atof(v);
+        else if (key == "seed") g_cfg.seed = strtoull(v, NULL, 10);
+        else if (key == "mtu") g_cfg.mtu = atoi(v);
+        else if (key == "wnd") g_cfg.wnd = atoi(v);
+        else if (key == "trace") g_cfg.trace = v;
+        else if (key == "stream") g_cfg.stream = atoi(v);
+        else if (key == "cork") g_cfg.cork_ms = atoi(v);
+        else if (key == "fec") sscanf(v, "%d,%d", &g_cfg.fec_k, &g_cfg.fec_m);
+        else if (key == "max_drop") g_cfg.max_drop = atof(v);
+        else fprintf(stderr, "unknown key '%s'\n", key.c_str());
+    }
+
+    if (g_cfg.msg_size < 16) g_cfg.msg_size = 16;
+    if (g_cfg.pairs < 1) g_cfg.pairs = 1;
+}
+
+static uint32_t sim_percentile(const std::vector<uint32_t> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+int main(int argc, char **argv) {
+    sim_parse(argc, argv);
+    g_rng = SimRng(g_cfg.seed);
+
+    auto wall_start = std::chrono::steady_clock::now();
+
+    DCPScheduler *scheduler = dcp_scheduler_create();
+    if (scheduler == nullptr) {
+        fprintf(stderr, "Failed to create scheduler\n");
+        return 1;
+    }
+
+    DCPTrace *trace = nullptr;
+    uint64_t trace_cursor = 0;
+    int trace_fd = -1;
+    if (!g_cfg.trace.empty()) {
+        trace = dcp_trace_create(1 << 16);
+        trace_fd = open(g_cfg.trace.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (trace == nullptr || trace_fd < 0 || dcp_trace_write_header(trace_fd) < 0) {
+            fprintf(stderr, "Failed to open trace '%s'\n", g_cfg.trace.c_str());
+            return 1;
+        }
+        dcp_scheduler_set_trace(scheduler, trace);
+    }
+
+    std::vector<SimPair> pairs(g_cfg.pairs);
+    std::vector<SimEndpoint> endpoints(g_cfg.pairs * 2);
+    for (int i = 0; i < g_cfg.pairs; i++) {
+        SimPair *pair = &pairs[i];
+        pair->index = i;
+        endpoints[i * 2] = SimEndpoint{pair, 0};
+        endpoints[i * 2 + 1] = SimEndpoint{pair, 1};
+
+        pair->a = dcp_create((uint32_t)i + 1, 0, &endpoints[i * 2], scheduler);
+        pair->b = dcp_create((uint32_t)i + 1, 0, &endpoints[i * 2 + 1], scheduler);
+        dcp_set_output(pair->a, sim_output);
+        dcp_set_output(pair->b, sim_output);
+        dcp_setmtu(pair->a, g_cfg.mtu);
+        dcp_setmtu(pair->b, g_cfg.mtu);
+        dcp_wndsize(pair->a, g_cfg.wnd, g_cfg.wnd);
+        dcp_wndsize(pair->b, g_cfg.wnd, g_cfg.wnd);
+        dcp_set_trace(pair->a, trace != nullptr);
+        if (g_cfg.stream) {
+            dcp_set_stream(pair->a, 1, g_cfg.cork_ms);
+            dcp_set_stream(pair->b, 1, 0);
+        }
+        if (g_cfg.fec_k > 0) {
+            dcp_set_fec(pair->a, g_cfg.fec_k, g_cfg.fec_m);
+            dcp_set_fec(pair->b, g_cfg.fec_k, 0);
+        }
+        sim_mark_dirty(pair);
+    }
+
+    uint64_t end_us = (uint64_t)(g_cfg.duration * 1e6);
+    uint64_t steps = 0;
+
+    for (SimPair &pair : pairs) {
+        pair.dirty = 0;
+        sim_service(&pair);
+    }
+    g_dirty.clear();
+
+    while (g_now_us < end_us) {
+        uint64_t next = end_us;
+        if (!g_events.empty() && g_events.top()->at_us < next) next = g_events.top()->at_us;
+
+        uint64_t expiry = dcp_scheduler_next_expiry_us(scheduler);
+        if (expiry < next) next = expiry;
+
+        if (g_cfg.rate > 0.0) {
+            for (SimPair &pair : pairs) {
+                if (pair.next_msg_us < next) next = pair.next_msg_us;
+            }
+        }
+        if (next > g_now_us) g_now_us = next;
+        steps++;
+
+        dcp_scheduler_run_us(scheduler, g_now_us);
+        uint32_t now_ms = (uint32_t)(g_now_us / 1000);
+        while (!g_events.empty() && g_events.top()->at_us <= g_now_us) {
+            SimEvent *ev = g_events.top();
+            g_events.pop();
+            DCPCB *target = ev->to_b ? ev->pair->b : ev->pair->a;
+            dcp_input(target, ev->data.data(), (long)ev->data.size(), now_ms);
+            sim_mark_dirty(ev->pair);
+            delete ev;
+        }
+
+        dcp_scheduler_run_us(scheduler, g_now_us);
+
+        if (g_cfg.rate > 0.0) {
+            for (SimPair &pair : pairs) {
+                if (pair.next_msg_us <= g_now_us) sim_mark_dirty(&pair);
+            }
+        }
+
+        for (size_t i = 0; i < g_dirty.size(); i++) {
+            g_dirty[i]->dirty = 0;
+            sim_service(g_dirty[i]);
+        }
+        g_dirty.clear();
+
+        if (trace != nullptr && trace->committed - trace_cursor > (trace->mask + 1) / 2) {
+            dcp_trace_dump(trace, &trace_cursor, trace_fd);
+        }
+    }
+
+    if (trace != nullptr) {
+        dcp_trace_dump(trace, &trace_cursor, trace_fd);
+        close(trace_fd);
+    }
+
+    uint64_t delivered = 0, msgs = 0, a_packets = 0, segments = 0;
+    uint64_t retrans = 0, rtos = 0, tlps = 0, losses = 0, parity = 0, recovered = 0;
+    double sum = 0.0, sum_sq = 0.0;
+    for (SimPair &pair : pairs) {
+        DCPStats stats;
+        dcp_get_stats(pair.a, &stats);
+        retrans += stats.segs_retrans;
+        rtos += stats.rto_timeouts;
+        tlps += stats.tlp_probes;
+        losses += stats.losses_detected;
+        parity += stats.fec_parity_sent;
+        a_packets -= stats.fec_parity_sent;
+        dcp_get_stats(pair.b, &stats);
+        recovered += stats.fec_recovered;
+
+        delivered += pair.delivered_bytes;
+        msgs += pair.delivered_msgs;
+        a_packets += pair.a_packets;
+        segments += pair.a->snd_nxt;
+        double g = (double)pair.delivered_bytes;
+        sum += g;
+        sum_sq += g * g;
+    }
+
+    std::sort(g_latency_us.begin(), g_latency_us.end());
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double seconds = (double)end_us / 1e6;
+
+    printf("config: pairs=%d bw=%.1fMbps rtt=%ums jitter=%ums queue=%u loss=%.4f ge=%.3f,%.3f,%.3f "
+           "reorder=%.3f msg=%d rate=%.1f duration=%.1fs seed=%llu\n",
+           g_cfg.pairs, g_cfg.bw_mbps, g_cfg.rtt_ms, g_cfg.jitter_ms, g_cfg.queue_pkts, g_cfg.loss,
+           g_cfg.ge_p, g_cfg.ge_r, g_cfg.ge_h, g_cfg.reorder, g_cfg.msg_size, g_cfg.rate,
+           g_cfg.duration, (unsigned long long)g_cfg.seed);
+    printf("goodput: %.3f Mbps (%.1f%% of link), messages=%llu, fairness=%.3f\n",
+           delivered * 8.0 / seconds / 1e6, delivered * 8.0 / seconds / 1e6 / g_cfg.bw_mbps * 100.0,
+           (unsigned long long)msgs, (sum_sq > 0.0) ? sum * sum / (g_cfg.pairs * sum_sq) : 0.0);
+    printf("retransmission: %.4f (%llu packets for %llu segments)\n",
+           segments ? (double)(a_packets > segments ? a_packets - segments : 0) / segments : 0.0,
+           (unsigned long long)a_packets, (unsigned long long)segments);
+    printf("recovery: retrans=%llu rto=%llu tlp=%llu lost=%llu\n",
+           (unsigned long long)retrans, (unsigned long long)rtos,
+           (unsigned long long)tlps, (unsigned long long)losses);
+    if (g_cfg.fec_k > 0) {
+        printf("fec: k=%d m=%d parity=%llu recovered=%llu\n", g_cfg.fec_k, g_cfg.fec_m,
+               (unsigned long long)parity, (unsigned long long)recovered);
+    }
+    printf("link: fwd packets=%llu lost=%llu dropped=%llu, rev packets=%llu lost=%llu dropped=%llu\n",
+           (unsigned long long)g_link[0].packets, (unsigned long long)g_link[0].lost,
+           (unsigned long long)g_link[0].dropped, (unsigned long long)g_link[1].packets,
+           (unsigned long long)g_link[1].lost, (unsigned long long)g_link[1].dropped);
+    printf("latency ms: p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f max=%.2f\n",
+           sim_percentile(g_latency_us, 0.50) / 1000.0, sim_percentile(g_latency_us, 0.90) / 1000.0,
+           sim_percentile(g_latency_us, 0.99) / 1000.0, sim_percentile(g_latency_us, 0.999) / 1000.0,
+           g_latency_us.empty() ? 0.0 : g_latency_us.back() / 1000.0);
+    printf("sim: %llu steps in %.2fs wall\n", (unsigned long long)steps, wall);
+
+    double drop_ratio = g_link[0].packets ? (double)g_link[0].dropped / g_link[0].packets : 0.0;
+    int status = 0;
+    if (g_cfg.max_drop >= 0.0 && drop_ratio > g_cfg.max_drop) {
+        printf("FAILED: drop ratio %.4f exceeds max_drop=%.4f\n", drop_ratio, g_cfg.max_drop);
+        status = 1;
+    }
+
+    while (!g_events.empty()) {
+        delete g_events.top();
+        g_events.pop();
+    }
+    for (SimPair &pair : pairs) {
+        dcp_release(pair.a);
+        dcp_release(pair.b);
+    }
+    dcp_scheduler_release(scheduler);
+    dcp_trace_release(trace);
+    return status;
+}
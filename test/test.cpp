@@ -126,7 +126,21 @@ int main(int argc, char **argv) {
             }
         }
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(DCP_TIMER_RESOLUTION));
+        now = get_current_time_ms();
+        int wait_ms = dcp_scheduler_next_timeout(scheduler, (uint64_t)now * 1000);
+        {
+            std::lock_guard<std::mutex> lock(g_network_mutex);
+            for (const Packet &pkt : g_network_queue) {
+                int due = (pkt.deliver_at_ms > now) ? (int)(pkt.deliver_at_ms - now) : 0;
+                if (wait_ms < 0 || due < wait_ms) wait_ms = due;
+            }
+        }
+        if (wait_ms < 0 || wait_ms > (int)(test_duration_ms - now)) {
+            wait_ms = (now < test_duration_ms) ? (int)(test_duration_ms - now) : 0;
+        }
+        if (wait_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+        }
     }
 
     if (!success) {
@@ -135,6 +149,16 @@ int main(int argc, char **argv) {
         std::cout << "Expected " << test_message.length() << " bytes, but received " << received_data.length() << std::endl;
     }
 
+    DCPStats stats_a;
+    DCPSchedulerStats sched_stats;
+    dcp_get_stats(endpoint_a.dcp, &stats_a);
+    dcp_scheduler_get_stats(scheduler, &sched_stats);
+    std::cout << "[Stats] A sent " << stats_a.segs_sent << " segs, retrans " << stats_a.segs_retrans
+              << ", srtt " << stats_a.srtt << "ms, cwnd " << stats_a.cwnd << std::endl;
+    std::cout << "[Stats] Scheduler fired " << sched_stats.timers_fired << " timers in "
+              << sched_stats.ticks << " ticks (max " << sched_stats.max_callbacks_per_tick
+              << " per tick)" << std::endl;
+
     dcp_release(endpoint_a.dcp);
     dcp_release(endpoint_b.dcp);
     dcp_scheduler_release(scheduler);